@@ -0,0 +1,432 @@
+#include "project.h"
+#include "psim.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*
+ * Deterministic top-off test generation (PODEM).
+ *
+ * The search assigns primary inputs only.  Lane 0 of a psim_t holds the
+ * current partial assignment: psim_good_update() implies the good machine
+ * and psim_propagate() the faulty one, so a line carries D when both
+ * machines are binary there and differ.  Objectives are chosen and
+ * backtraced to a primary input with the SCOAP measures.
+ */
+
+/* good / faulty value of gate i in lane 0 */
+#define good_val(ps, i)                                                       \
+  (((ps)->one[i] & 1) ? LOGIC_1 : ((ps)->zero[i] & 1) ? LOGIC_0 : LOGIC_X)
+#define faulty_val(ps, i)                                                     \
+  (((ps)->stamp[i] != (ps)->now) ? good_val(ps, i)                            \
+   : ((ps)->fone[i] & 1)         ? LOGIC_1                                    \
+   : ((ps)->fzero[i] & 1)        ? LOGIC_0                                    \
+                                 : LOGIC_X)
+
+/* search state of one fault */
+typedef struct podem_struct podem_t;
+struct podem_struct
+{
+  psim_t *ps;
+  fault_list_t *fault;
+  int *cc0, *cc1, *co; /* SCOAP measures */
+  int *pi_pos;         /* position of a PI gate in ckt->pi[], -1 otherwise */
+  int *value;          /* current PI assignment, pattern file order */
+  int *applied;        /* PI values the good machine holds */
+  int *changed;        /* PI gates changed since the last implication */
+  char *xpath;         /* gate has an X path to an observed PO */
+  int complete;        /* FALSE once a branch is given up on a heuristic */
+};
+
+/* apply the changed PI values and simulate both machines */
+static word_t imply(podem_t *pd)
+{
+  circuit_t *ckt = pd->ps->ckt;
+  psim_t *ps = pd->ps;
+  inject_t inj;
+  int i, g, n;
+
+  for (i = 0, n = 0; i < ckt->npi; i++)
+  {
+    if ((g = ckt->pi[i]) < 0 || pd->value[i] == pd->applied[i])
+      continue;
+    ps->zero[g] = (pd->value[i] == LOGIC_0) ? ALL_ONES : 0;
+    ps->one[g] = (pd->value[i] == LOGIC_1) ? ALL_ONES : 0;
+    pd->applied[i] = pd->value[i];
+    pd->changed[n++] = g;
+  }
+  psim_good_update(ps, pd->changed, n);
+  psim_fault_inject(pd->fault, &inj);
+  return (psim_propagate(ps, &inj, 1));
+}
+
+/* TRUE if input k of gate i carries the fault effect */
+static int input_has_d(podem_t *pd, int i, int k)
+{
+  psim_t *ps = pd->ps;
+  fault_list_t *fptr = pd->fault;
+  int line = ps->ckt->gate[i].fanin[k];
+  int gv, fv;
+
+  gv = good_val(ps, line);
+  if (fptr->gate_index == i && fptr->input_index == k)
+    return (gv == ((fptr->type == S_A_0) ? LOGIC_1 : LOGIC_0));
+  fv = faulty_val(ps, line);
+  return (gv != LOGIC_X && fv != LOGIC_X && gv != fv);
+}
+
+/* fill pd->xpath[]: a gate whose value is X in either machine and that
+   is an observed PO or feeds a gate with an X path */
+static void mark_xpath(podem_t *pd)
+{
+  circuit_t *ckt = pd->ps->ckt;
+  psim_t *ps = pd->ps;
+  gate_t *g;
+  int i, j;
+
+  /* only gates after the fault site can carry its effect */
+  for (i = ckt->ngates - 1; i >= pd->fault->gate_index; i--)
+  {
+    g = &ckt->gate[i];
+    pd->xpath[i] = FALSE;
+    if (good_val(ps, i) != LOGIC_X && faulty_val(ps, i) != LOGIC_X)
+      continue;
+    if (ps->po_pos[i] >= 0 && ps->observe[i])
+      pd->xpath[i] = TRUE;
+    for (j = 0; j < g->num_fanout && !pd->xpath[i]; j++)
+      pd->xpath[i] = pd->xpath[g->fanout[j]];
+  }
+}
+
+/*************************************************************************
+
+Function:  objective
+
+Purpose:  Picks the next line value to aim for: the fault excitation
+while the fault site is X, otherwise a non-controlling value on an X input
+of the D-frontier gate that is easiest to observe.  Frontier gates with
+no X path to an observed primary output are ignored.
+
+Return:  TRUE with *gate / *val set, FALSE if the current assignment
+cannot lead to a test.
+
+*************************************************************************/
+
+static int objective(podem_t *pd, int *gate, int *val)
+{
+  circuit_t *ckt = pd->ps->ckt;
+  psim_t *ps = pd->ps;
+  fault_list_t *fptr = pd->fault;
+  gate_t *g;
+  int line, excite, i, k, best, best_k, frontier;
+
+  line = (fptr->input_index < 0) ? fptr->gate_index
+                                 : ckt->gate[fptr->gate_index]
+                                       .fanin[fptr->input_index];
+  excite = (fptr->type == S_A_0) ? LOGIC_1 : LOGIC_0;
+  if (good_val(ps, line) == LOGIC_X)
+  {
+    *gate = line;
+    *val = excite;
+    return (TRUE);
+  }
+  if (good_val(ps, line) != excite)
+    return (FALSE);
+
+  /* D-frontier: an input carries D, the output is not yet decided */
+  mark_xpath(pd);
+  best = -1;
+  best_k = -1;
+  frontier = FALSE;
+  for (i = fptr->gate_index; i < ckt->ngates; i++)
+  {
+    if (i != fptr->gate_index && ps->stamp[i] != ps->now)
+    {
+      /* only fanouts of disturbed gates can be on the frontier */
+      g = &ckt->gate[i];
+      if (g->type == PI || g->type == PO_GND || g->type == PO_VCC)
+        continue;
+      if ((g->fanin[0] < 0 || ps->stamp[g->fanin[0]] != ps->now) &&
+          (g->fanin[1] < 0 || ps->stamp[g->fanin[1]] != ps->now))
+        continue;
+    }
+    g = &ckt->gate[i];
+    if (g->type != AND && g->type != NAND && g->type != OR && g->type != NOR)
+      continue;
+    if (!pd->xpath[i])
+      continue;
+    for (k = 0; k < MAX_GATE_FANIN; k++)
+    {
+      if (input_has_d(pd, i, k))
+        break;
+    }
+    if (k == MAX_GATE_FANIN)
+      continue;
+    frontier = TRUE;
+    if (good_val(ps, g->fanin[1 - k]) != LOGIC_X)
+      continue;
+    if (best < 0 || pd->co[i] < pd->co[best])
+    {
+      best = i;
+      best_k = 1 - k;
+    }
+  }
+  if (best < 0)
+  {
+    /* a frontier gate may wait on a line that is X in the faulty machine
+       only; that case is not searched */
+    if (frontier)
+      pd->complete = FALSE;
+    return (FALSE);
+  }
+  g = &ckt->gate[best];
+  *gate = g->fanin[best_k];
+  *val = (g->type == AND || g->type == NAND) ? LOGIC_1 : LOGIC_0;
+  return (TRUE);
+}
+
+/*************************************************************************
+
+Function:  backtrace
+
+Purpose:  Follows X lines from the objective back to a primary input.
+Where one input suffices the easiest one is taken, where all inputs are
+needed the hardest one, so that conflicts show up early.
+
+Return:  Position of the primary input in ckt->pi[] with *val set, -1 if
+no X path leads to a primary input.
+
+*************************************************************************/
+
+static int backtrace(podem_t *pd, int gate, int *val)
+{
+  circuit_t *ckt = pd->ps->ckt;
+  psim_t *ps = pd->ps;
+  gate_t *g;
+  int v = *val;
+  int k, in, all, c, best, best_c;
+
+  while (ckt->gate[gate].type != PI)
+  {
+    g = &ckt->gate[gate];
+    switch (g->type)
+    {
+    case INV:
+    case NAND:
+    case NOR:
+      v = (v == LOGIC_1) ? LOGIC_0 : LOGIC_1;
+      break;
+    case PO_GND:
+    case PO_VCC:
+      return (-1);
+    default:
+      break;
+    }
+    /* v is now wanted on the inputs of an AND/OR/BUF */
+    if (g->type == AND || g->type == NAND)
+      all = (v == LOGIC_1);
+    else if (g->type == OR || g->type == NOR)
+      all = (v == LOGIC_0);
+    else
+      all = FALSE;
+    best = -1;
+    best_c = 0;
+    for (k = 0; k < MAX_GATE_FANIN; k++)
+    {
+      in = g->fanin[k];
+      if (in < 0 || good_val(ps, in) != LOGIC_X)
+        continue;
+      c = (v == LOGIC_1) ? pd->cc1[in] : pd->cc0[in];
+      if (best < 0 || (all ? c > best_c : c < best_c))
+      {
+        best = in;
+        best_c = c;
+      }
+    }
+    if (best < 0)
+      return (-1);
+    gate = best;
+  }
+  *val = v;
+  return (pd->pi_pos[gate]);
+}
+
+/*************************************************************************
+
+Function:  podem
+
+Purpose:  Searches a primary input assignment detecting pd->fault,
+giving up after "limit" backtracks.  On success pd->value holds the test
+with LOGIC_X on the inputs left free.
+
+Return:  ATPG_DETECTED, ATPG_UNTESTABLE (search space exhausted) or
+ATPG_ABORTED.
+
+*************************************************************************/
+
+static int podem(podem_t *pd, int *stack, char *flipped, int limit)
+{
+  circuit_t *ckt = pd->ps->ckt;
+  int depth, backtracks, gate, val, pos;
+
+  for (pos = 0; pos < ckt->npi; pos++)
+    pd->value[pos] = LOGIC_X;
+  pd->complete = TRUE;
+  depth = 0;
+  backtracks = 0;
+  for (;;)
+  {
+    if (imply(pd))
+      return (ATPG_DETECTED);
+    if (objective(pd, &gate, &val) && (pos = backtrace(pd, gate, &val)) >= 0)
+    {
+      pd->value[pos] = val;
+      stack[depth] = pos;
+      flipped[depth] = FALSE;
+      depth++;
+      continue;
+    }
+    /* undo the decisions whose both values failed, flip the last one */
+    while (depth > 0 && flipped[depth - 1])
+    {
+      depth--;
+      pd->value[stack[depth]] = LOGIC_X;
+    }
+    if (depth == 0)
+      return (pd->complete ? ATPG_UNTESTABLE : ATPG_ABORTED);
+    if (++backtracks > limit)
+      return (ATPG_ABORTED);
+    pos = stack[depth - 1];
+    pd->value[pos] = (pd->value[pos] == LOGIC_1) ? LOGIC_0 : LOGIC_1;
+    flipped[depth - 1] = TRUE;
+  }
+}
+
+/*************************************************************************
+
+Function:  atpg_top_off
+
+Purpose:  Runs PODEM on every fault of undetected_flist, in list order.
+Each test found has its free inputs filled at random (from "seed"), is
+appended to pat (pat.out[][] included) and is fault simulated at once
+against the faults still undetected, which drops the target fault and
+usually a few others.  Counts of the outcomes go to *stats.
+
+Return:  List of faults that remain undetected, in their original order.
+
+*************************************************************************/
+
+fault_list_t *atpg_top_off(circuit_t *ckt, pattern_t *pat,
+                           fault_list_t *undetected_flist, int limit,
+                           unsigned long seed, atpg_stats_t *stats)
+{
+  podem_t pd;
+  psim_t *ps;
+  fault_list_t **faults;
+  char *detected, *flipped, *untestable;
+  inject_t inj;
+  word_t rnd;
+  int *stack, nfaults, f, i, r;
+
+  faults = psim_fault_array(undetected_flist, &nfaults);
+  detected = (char *)calloc(nfaults + 1, sizeof(char));
+  untestable = (char *)calloc(nfaults + 1, sizeof(char));
+
+  ps = psim_create(ckt);
+  pd.ps = ps;
+  pd.cc0 = (int *)malloc(ckt->ngates * sizeof(int));
+  pd.cc1 = (int *)malloc(ckt->ngates * sizeof(int));
+  pd.co = (int *)malloc(ckt->ngates * sizeof(int));
+  scoap_measures(ckt, pd.cc0, pd.cc1, pd.co);
+  pd.pi_pos = (int *)malloc(ckt->ngates * sizeof(int));
+  for (i = 0; i < ckt->ngates; i++)
+    pd.pi_pos[i] = -1;
+  for (i = 0; i < ckt->npi; i++)
+  {
+    if (ckt->pi[i] >= 0)
+      pd.pi_pos[ckt->pi[i]] = i;
+  }
+  pd.value = (int *)malloc((ckt->npi + 1) * sizeof(int));
+  pd.applied = (int *)malloc((ckt->npi + 1) * sizeof(int));
+  pd.changed = (int *)malloc((ckt->npi + 1) * sizeof(int));
+  pd.xpath = (char *)malloc(ckt->ngates);
+  stack = (int *)malloc((ckt->npi + 1) * sizeof(int));
+  flipped = (char *)malloc(ckt->npi + 1);
+  rnd = (seed != 0) ? seed : 1;
+  memset(stats, 0, sizeof(atpg_stats_t));
+
+  /* start from all inputs X */
+  for (i = 0; i < ckt->npi; i++)
+  {
+    pd.applied[i] = LOGIC_X;
+    if (ckt->pi[i] >= 0)
+      ps->zero[ckt->pi[i]] = ps->one[ckt->pi[i]] = 0;
+  }
+  ps->valid = LANE(0);
+  psim_good_eval(ps);
+
+  for (f = 0; f < nfaults && pat->len < MAX_PATTERNS; f++)
+  {
+    if (detected[f])
+      continue;
+    pd.fault = faults[f];
+    r = podem(&pd, stack, flipped, limit);
+    if (r == ATPG_UNTESTABLE)
+    {
+      untestable[f] = TRUE;
+      stats->untestable++;
+      continue;
+    }
+    if (r == ATPG_ABORTED)
+    {
+      stats->aborted++;
+      continue;
+    }
+
+    /* random fill, then drop every fault the new pattern detects */
+    for (i = 0; i < ckt->npi; i++)
+    {
+      if (pd.value[i] == LOGIC_X)
+        pd.value[i] = (psim_random(&rnd) >> 63) ? LOGIC_1 : LOGIC_0;
+    }
+    pat->in[pat->len] = (int *)malloc(ckt->npi * sizeof(int));
+    pat->out[pat->len] = (int *)malloc(ckt->npo * sizeof(int));
+    memcpy(pat->in[pat->len], pd.value, ckt->npi * sizeof(int));
+    imply(&pd);
+    psim_store_outputs(ps, pat, pat->len);
+    pat->len++;
+    stats->patterns++;
+    /* the faults aborted so far may be detected by the new pattern too */
+    for (i = 0; i < nfaults; i++)
+    {
+      if (detected[i] || untestable[i])
+        continue;
+      psim_fault_inject(faults[i], &inj);
+      if (psim_propagate(ps, &inj, 1))
+      {
+        detected[i] = TRUE;
+        faults[i]->detect_index = pat->len - 1;
+      }
+    }
+    assert(detected[f]);
+  }
+  psim_free(ps);
+
+  undetected_flist = psim_unlink_detected(faults, detected, nfaults);
+  free(faults);
+  free(detected);
+  free(untestable);
+  free(pd.cc0);
+  free(pd.cc1);
+  free(pd.co);
+  free(pd.pi_pos);
+  free(pd.value);
+  free(pd.applied);
+  free(pd.changed);
+  free(pd.xpath);
+  free(stack);
+  free(flipped);
+  return (undetected_flist);
+}
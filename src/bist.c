@@ -0,0 +1,233 @@
+#include "project.h"
+#include "psim.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <assert.h>
+
+/*
+ * Logic BIST emulation.
+ *
+ * The test patterns come from an external-XOR LFSR through an XOR phase
+ * shifter and the primary output responses are compacted in a MISR, as on
+ * chip.  Patterns are produced WORD_BITS at a time straight into the
+ * primary input words, so no pattern file is read or written.
+ *
+ * For a block starting at cycle T the LFSR cells hold the bit stream s[]
+ * (cell j = s[T + j] at cycle T), so the word of cell j over the block is
+ * s[T + j .. T + j + 63].  The stream window s[T .. T + n + 63] of a degree
+ * n LFSR fits in 128 bits.
+ */
+
+typedef unsigned __int128 stream_t;
+
+/* degree of a polynomial given with its leading term */
+#define poly_degree(p) (63 - __builtin_clzll(p))
+
+/* a[i] bit j <- a[j] bit i */
+static void transpose64(word_t a[WORD_BITS])
+{
+  int j, k;
+  word_t m, t;
+
+  for (j = 32, m = 0x00000000FFFFFFFFULL; j != 0; j >>= 1, m ^= (m << j))
+  {
+    for (k = 0; k < WORD_BITS; k = ((k | j) + 1) & ~j)
+    {
+      t = ((a[k] >> j) ^ a[k | j]) & m;
+      a[k] ^= t << j;
+      a[k | j] ^= t;
+    }
+  }
+}
+
+/*************************************************************************
+
+Function:  bist_check
+
+Purpose:  Validates the LFSR and MISR polynomials of a BIST setup; exits
+with a message if one is unusable.
+
+*************************************************************************/
+
+void bist_check(bist_t *bist)
+{
+  if (bist->lfsr_poly < 4 || (bist->lfsr_poly >> 63) != 0 ||
+      (bist->lfsr_poly & 1) == 0)
+  {
+    fprintf(stderr, "ERROR:  LFSR polynomial 0x%llx must have degree 2..62 "
+                    "and a constant term\n", bist->lfsr_poly);
+    exit(-1);
+  }
+  if (bist->misr_poly < 4 || (bist->misr_poly >> 63) != 0 ||
+      (bist->misr_poly & 1) == 0)
+  {
+    fprintf(stderr, "ERROR:  MISR polynomial 0x%llx must have degree 2..62 "
+                    "and a constant term\n", bist->misr_poly);
+    exit(-1);
+  }
+  bist->lfsr_seed &= (LANE(poly_degree(bist->lfsr_poly)) - 1);
+  if (bist->lfsr_seed == 0)
+  {
+    fprintf(stderr, "ERROR:  LFSR seed must be non-zero\n");
+    exit(-1);
+  }
+}
+
+/*************************************************************************
+
+Function:  bist_fault_simulate
+
+Purpose:  Applies bist->npatterns LFSR patterns to the circuit, fills in
+the fault-free MISR signature (bist->signature) and drops the faults that
+reach a primary output.  Detection is judged at the outputs, before the
+MISR, so aliasing in the MISR is not modelled.
+
+The phase shifter drives primary input i with the XOR of bist->phase_taps
+LFSR cells picked with "seed".
+
+Return:  List of faults that remain undetected, in their original order.
+
+*************************************************************************/
+
+fault_list_t *bist_fault_simulate(circuit_t *ckt, bist_t *bist,
+                                  fault_list_t *undetected_flist,
+                                  unsigned long seed)
+{
+  psim_t *ps;
+  fault_list_t **faults;
+  char *detected;
+  inject_t inj;
+  int *tap, ntaps, n, m, nfaults, nlive, f, i, j, k, p;
+  word_t *cell, stage[WORD_BITS], state, lfsr_taps, misr_taps, misr_mask, w,
+      fb, rnd, d;
+  stream_t s;
+  unsigned long long applied;
+
+  faults = psim_fault_array(undetected_flist, &nfaults);
+  detected = (char *)calloc(nfaults + 1, sizeof(char));
+
+  n = poly_degree(bist->lfsr_poly);
+  lfsr_taps = bist->lfsr_poly & (LANE(n) - 1);
+  m = poly_degree(bist->misr_poly);
+  misr_mask = LANE(m) - 1;
+  misr_taps = bist->misr_poly & misr_mask;
+
+  /* phase shifter: ntaps distinct cells per primary input */
+  ntaps = bist->phase_taps;
+  if (ntaps < 1)
+    ntaps = 1;
+  if (ntaps > n)
+    ntaps = n;
+  tap = (int *)malloc((ckt->npi * ntaps + 1) * sizeof(int));
+  rnd = (seed != 0) ? seed : 1;
+  for (i = 0; i < ckt->npi; i++)
+  {
+    tap[i * ntaps] = i % n;
+    for (k = 1; k < ntaps; k++)
+    {
+      do
+      {
+        tap[i * ntaps + k] = psim_random(&rnd) % (word_t)n;
+        for (j = 0; j < k; j++)
+          if (tap[i * ntaps + j] == tap[i * ntaps + k])
+            break;
+      } while (j < k);
+    }
+  }
+  cell = (word_t *)malloc(n * sizeof(word_t));
+
+  ps = psim_create(ckt);
+  state = bist->lfsr_seed;
+  bist->signature = 0;
+  bist->nx = 0;
+  nlive = nfaults;
+  for (applied = 0; applied < bist->npatterns; applied += WORD_BITS)
+  {
+    /* extend the stream by WORD_BITS bits: s[t + n] = sum of tapped s[t + i] */
+    s = (stream_t)state;
+    for (p = 0; p < WORD_BITS; p++)
+    {
+      w = (word_t)(s >> p) & lfsr_taps;
+      s |= (stream_t)__builtin_parityll(w) << (p + n);
+    }
+    for (j = 0; j < n; j++)
+      cell[j] = (word_t)(s >> j);
+    state = (word_t)(s >> WORD_BITS) & (LANE(n) - 1);
+
+    for (i = 0; i < ckt->npi; i++)
+    {
+      if (ckt->pi[i] < 0)
+        continue;
+      for (w = 0, k = 0; k < ntaps; k++)
+        w ^= cell[tap[i * ntaps + k]];
+      ps->one[ckt->pi[i]] = w;
+      ps->zero[ckt->pi[i]] = ~w;
+    }
+    ps->valid = (bist->npatterns - applied >= WORD_BITS)
+                    ? ALL_ONES
+                    : LANE(bist->npatterns - applied) - 1;
+    psim_good_eval(ps);
+
+    /* fold the outputs onto the MISR stages and clock it once per pattern */
+    memset(stage, 0, sizeof(stage));
+    for (j = 0; j < ckt->npo; j++)
+    {
+      /* masked outputs are gated off before the MISR */
+      if (ckt->po_mask != NULL && ckt->po_mask[j])
+        continue;
+      stage[j % m] ^= ps->one[ckt->po[j]];
+      bist->nx += popcount(~(ps->zero[ckt->po[j]] | ps->one[ckt->po[j]]) &
+                           ps->valid);
+    }
+    transpose64(stage);
+    for (p = 0; p < WORD_BITS && (ps->valid & LANE(p)); p++)
+    {
+      fb = (bist->signature >> (m - 1)) & 1;
+      bist->signature = ((bist->signature << 1) & misr_mask) ^
+                        (fb ? misr_taps : 0) ^ (stage[p] & misr_mask);
+    }
+
+    for (f = 0; f < nfaults && nlive > 0; f++)
+    {
+      if (detected[f])
+        continue;
+      psim_fault_inject(faults[f], &inj);
+      if ((d = psim_propagate(ps, &inj, 1)) != 0)
+      {
+        detected[f] = TRUE;
+        /* pattern numbers past INT_MAX saturate */
+        faults[f]->detect_index = (applied + lowest_lane(d) < INT_MAX)
+                                      ? (int)(applied + lowest_lane(d))
+                                      : INT_MAX;
+        nlive--;
+      }
+    }
+  }
+  psim_free(ps);
+  free(tap);
+  free(cell);
+
+  undetected_flist = psim_unlink_detected(faults, detected, nfaults);
+  free(faults);
+  free(detected);
+  return (undetected_flist);
+}
+
+/* write the BIST setup and the fault-free signature */
+void write_bist_signature(bist_t *bist, FILE *out_file)
+{
+  fprintf(out_file, "BIST Patterns = %llu\n", bist->npatterns);
+  fprintf(out_file, "LFSR Polynomial = 0x%llx, Seed = 0x%llx, Phase Shifter "
+                    "Taps = %d\n", bist->lfsr_poly, bist->lfsr_seed,
+          bist->phase_taps);
+  fprintf(out_file, "MISR Polynomial = 0x%llx\n", bist->misr_poly);
+  if (bist->nx > 0)
+    fprintf(out_file, "Golden Signature = unknown (%llu X values captured)\n",
+            bist->nx);
+  else
+    fprintf(out_file, "Golden Signature = 0x%0*llx\n",
+            (poly_degree(bist->misr_poly) + 3) / 4, bist->signature);
+}
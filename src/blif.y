@@ -142,7 +142,7 @@ char                    **signalArray;
 %token		    BLIF_MODEL BLIF_INPUTS BLIF_OUTPUTS 
 %token		    BLIF_NAMES BLIF_END
 %token	<sval>	    NAME  GATE_COVER
-%token              LINE_CONT BLIF_SEQ BLIF_FSM
+%token              LINE_CONT BLIF_SEQ BLIF_FSM BLIF_LATCH
 
 %type   <sval>      signal_list
 %type   <sval>      cover_list
@@ -369,6 +369,7 @@ commandlist:	commandlist command
 
 
 command:		logic_gate
+				| latch
 				;		
 
 logic_gate:    BLIF_NAMES  signal_list cover_list
@@ -445,6 +446,33 @@ logic_gate:    BLIF_NAMES  signal_list cover_list
                 ;
 
 
+/******************************************************************\
+ * .latch input output [type control] [init-val]
+ * The circuit is simulated as full-scan: the latch output becomes a
+ * pseudo primary input and the latch input a pseudo primary output.
+ * The type, control and initial value are not used.
+\******************************************************************/
+latch:		BLIF_LATCH signal_list
+                {
+		int i;
+#ifdef DEBUG_MESSAGES
+		  printf("latch parsed\n");
+#endif 
+		  if(signalNum < 2){
+			printf("Invalid Latch in Circuit\n");
+			exit(-1);
+		  }
+		  Add_Latch(signalArray[0], signalArray[1]);
+		  for(i=0; i<signalNum; i++){
+			free(signalArray[i]);
+		  }
+		  free(signalArray);
+		  gateInfo.GateType = nodeKind = UNKNOWN;
+		  signalNum = 0;
+		  signalArray = NULL;
+		}
+                ;
+
 cover_list :    cover_list  GATE_COVER
                 {
 #ifdef DEBUG_MESSAGES
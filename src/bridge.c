@@ -0,0 +1,361 @@
+#include "read_ckt.h"
+#include "psim.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*
+ * Bridging fault simulation.
+ *
+ * A bridge shorts the nets driven by gate_a and gate_b.  WIRED_AND and
+ * WIRED_OR bridges give both nets the AND (OR) of their fault-free values;
+ * a DOMINANT bridge forces net b to the value of net a.  Only non-feedback
+ * bridges are simulated, so the faulty value of either net is a function of
+ * the good values of both and the bridge is injected as two output faults
+ * that are propagated together by psim_propagate().
+ */
+
+extern void write_patterns(); /* defined in main.c */
+
+static char *bridge_name[] = {"AND", "OR ", "DOM"};
+
+/* TRUE if gate "to" is in the transitive fanout of gate "from" */
+static int in_fanout_cone(circuit_t *ckt, int from, int to, int *stack,
+                          char *seen)
+{
+  int i, j, top, found;
+
+  if (from > to)
+    return (FALSE);
+  found = FALSE;
+  top = 0;
+  stack[top++] = from;
+  seen[from] = TRUE;
+  while (top > 0 && !found)
+  {
+    i = stack[--top];
+    for (j = 0; j < ckt->gate[i].num_fanout; j++)
+    {
+      if (ckt->gate[i].fanout[j] == to)
+        found = TRUE;
+      /* gates are stored in topological order */
+      if ((ckt->gate[i].fanout[j] < to) && !seen[ckt->gate[i].fanout[j]])
+      {
+        seen[ckt->gate[i].fanout[j]] = TRUE;
+        stack[top++] = ckt->gate[i].fanout[j];
+      }
+    }
+  }
+  memset(seen, 0, ckt->ngates * sizeof(char));
+  return (found);
+}
+
+static int is_net(circuit_t *ckt, int i)
+{
+  switch (ckt->gate[i].type)
+  {
+  case PO:
+  case PO_GND:
+  case PO_VCC:
+    return (FALSE);
+  default:
+    return (TRUE);
+  }
+}
+
+static bridge_list_t *add_bridge(bridge_list_t *blist, int gate_a, int gate_b,
+                                 bridge_type_t type)
+{
+  bridge_list_t *new_bridge;
+
+  new_bridge = (bridge_list_t *)malloc(sizeof(bridge_list_t));
+  new_bridge->gate_a = gate_a;
+  new_bridge->gate_b = gate_b;
+  new_bridge->type = type;
+  new_bridge->next = blist;
+  return (new_bridge);
+}
+
+/* reverse a list built by prepending so it follows input order */
+static bridge_list_t *reverse_bridges(bridge_list_t *blist)
+{
+  bridge_list_t *prev, *next;
+
+  for (prev = NULL; blist != NULL; blist = next)
+  {
+    next = blist->next;
+    blist->next = prev;
+    prev = blist;
+  }
+  return (prev);
+}
+
+/*************************************************************************
+
+Function:  read_bridge_list
+
+Purpose:  Reads bridges from a file with one bridge per line:
+
+    AND net_a net_b     wired-AND
+    OR  net_a net_b     wired-OR
+    DOM net_a net_b     net_a dominates net_b
+
+Blank lines and lines starting with '#' are skipped.  Unknown nets and
+feedback bridges are reported and skipped.
+
+Return:  List of bridges in file order.
+
+*************************************************************************/
+
+bridge_list_t *read_bridge_list(circuit_t *ckt, FILE *bridge_file)
+{
+  bridge_list_t *blist;
+  char line[1024], type[16], net_a[480], net_b[480];
+  int gate_a, gate_b, line_count, *stack;
+  char *seen;
+  bridge_type_t btype;
+
+  stack = (int *)malloc(ckt->ngates * sizeof(int));
+  seen = (char *)calloc(ckt->ngates, sizeof(char));
+  blist = (bridge_list_t *)NULL;
+  line_count = 0;
+  while (fgets(line, sizeof(line), bridge_file) != NULL)
+  {
+    line_count++;
+    if (sscanf(line, "%15s", type) != 1 || type[0] == '#')
+      continue;
+    if (sscanf(line, "%15s %479s %479s", type, net_a, net_b) != 3)
+    {
+      fprintf(stderr, "ERROR:  bridge list line %d is malformed\n",
+              line_count);
+      exit(-1);
+    }
+    if (strcmp(type, "AND") == 0)
+      btype = WIRED_AND;
+    else if (strcmp(type, "OR") == 0)
+      btype = WIRED_OR;
+    else if (strcmp(type, "DOM") == 0)
+      btype = DOMINANT;
+    else
+    {
+      fprintf(stderr, "ERROR:  unknown bridge type %s on line %d\n", type,
+              line_count);
+      exit(-1);
+    }
+    gate_a = Find_Gate(net_a, FALSE);
+    gate_b = Find_Gate(net_b, FALSE);
+    if (gate_a < 0 || gate_b < 0 || gate_a == gate_b)
+    {
+      printf("Warning: skipping bridge %s %s on line %d (unknown net)\n",
+             net_a, net_b, line_count);
+      continue;
+    }
+    if (in_fanout_cone(ckt, gate_a, gate_b, stack, seen) ||
+        in_fanout_cone(ckt, gate_b, gate_a, stack, seen))
+    {
+      printf("Warning: skipping feedback bridge %s %s on line %d\n", net_a,
+             net_b, line_count);
+      continue;
+    }
+    blist = add_bridge(blist, gate_a, gate_b, btype);
+  }
+  free(stack);
+  free(seen);
+  return (reverse_bridges(blist));
+}
+
+/*************************************************************************
+
+Function:  sample_bridge_list
+
+Purpose:  Picks up to "npairs" pairs of structurally adjacent nets: the two
+fanins of a 2-input gate, and gates stored next to each other in the same
+level.  Each non-feedback pair yields a wired-AND, a wired-OR and both
+dominant bridges.
+
+Return:  List of sampled bridges.
+
+*************************************************************************/
+
+bridge_list_t *sample_bridge_list(circuit_t *ckt, int npairs,
+                                  unsigned long seed)
+{
+  psim_t *ps;
+  bridge_list_t *blist;
+  int *cand_a, *cand_b, *stack;
+  int ncand, i, k, t, a, b;
+  char *seen;
+  word_t state;
+
+  cand_a = (int *)malloc(2 * ckt->ngates * sizeof(int));
+  cand_b = (int *)malloc(2 * ckt->ngates * sizeof(int));
+  stack = (int *)malloc(ckt->ngates * sizeof(int));
+  seen = (char *)calloc(ckt->ngates, sizeof(char));
+
+  ps = psim_create(ckt);
+  ncand = 0;
+  for (i = 0; i < ckt->ngates; i++)
+  {
+    switch (ckt->gate[i].type)
+    {
+    case AND:
+    case NAND:
+    case OR:
+    case NOR:
+      a = ckt->gate[i].fanin[0];
+      b = ckt->gate[i].fanin[1];
+      if (a != b && is_net(ckt, a) && is_net(ckt, b))
+      {
+        cand_a[ncand] = a;
+        cand_b[ncand++] = b;
+      }
+      break;
+    default:
+      break;
+    }
+    if (i + 1 < ckt->ngates && is_net(ckt, i) && is_net(ckt, i + 1) &&
+        ps->level[i] == ps->level[i + 1])
+    {
+      cand_a[ncand] = i;
+      cand_b[ncand++] = i + 1;
+    }
+  }
+  psim_free(ps);
+
+  state = (seed != 0) ? seed : 1;
+  blist = (bridge_list_t *)NULL;
+  for (k = 0; k < ncand && npairs > 0; k++)
+  {
+    /* partial Fisher-Yates shuffle of the candidate pairs */
+    t = k + (int)(psim_random(&state) % (word_t)(ncand - k));
+    a = cand_a[t];
+    b = cand_b[t];
+    cand_a[t] = cand_a[k];
+    cand_b[t] = cand_b[k];
+    if (in_fanout_cone(ckt, a, b, stack, seen) ||
+        in_fanout_cone(ckt, b, a, stack, seen))
+      continue;
+    blist = add_bridge(blist, a, b, WIRED_AND);
+    blist = add_bridge(blist, a, b, WIRED_OR);
+    blist = add_bridge(blist, a, b, DOMINANT);
+    blist = add_bridge(blist, b, a, DOMINANT);
+    npairs--;
+  }
+  free(cand_a);
+  free(cand_b);
+  free(stack);
+  free(seen);
+  return (reverse_bridges(blist));
+}
+
+/* describe bridge *bptr for the current block as injections, return count */
+static int bridge_inject(psim_t *ps, bridge_list_t *bptr, inject_t *inj)
+{
+  word_t az = ps->zero[bptr->gate_a], ao = ps->one[bptr->gate_a];
+  word_t bz = ps->zero[bptr->gate_b], bo = ps->one[bptr->gate_b];
+  word_t z, o;
+
+  switch (bptr->type)
+  {
+  case WIRED_AND:
+    z = az | bz;
+    o = ao & bo;
+    break;
+  case WIRED_OR:
+    z = az & bz;
+    o = ao | bo;
+    break;
+  case DOMINANT:
+    inj[0].gate_index = bptr->gate_b;
+    inj[0].input_index = -1;
+    inj[0].lanes = ALL_ONES;
+    inj[0].zero = az;
+    inj[0].one = ao;
+    return (1);
+  default:
+    assert(0);
+  }
+  inj[0].gate_index = bptr->gate_a;
+  inj[1].gate_index = bptr->gate_b;
+  inj[0].input_index = inj[1].input_index = -1;
+  inj[0].lanes = inj[1].lanes = ALL_ONES;
+  inj[0].zero = inj[1].zero = z;
+  inj[0].one = inj[1].one = o;
+  return (2);
+}
+
+/*************************************************************************
+
+Function:  bridge_fault_simulate
+
+Purpose:  Simulates the bridges in undetected_blist against the patterns,
+WORD_BITS patterns at a time, dropping bridges once detected.
+
+pat.out[][] is filled with the fault-free output patterns corresponding to
+the input patterns in pat.in[][].
+
+Return:  List of bridges that remain undetected.
+
+*************************************************************************/
+
+bridge_list_t *bridge_fault_simulate(circuit_t *ckt, pattern_t *pat,
+                                     bridge_list_t *undetected_blist)
+{
+  psim_t *ps;
+  bridge_list_t *bptr, **bridges;
+  char *detected;
+  inject_t inj[2];
+  int nbridges, b, first, ninj;
+
+  LIST_TO_ARRAY(undetected_blist, bptr, bridges, nbridges);
+  detected = (char *)calloc(nbridges + 1, sizeof(char));
+
+  ps = psim_create(ckt);
+  for (first = 0; first < pat->len; first += WORD_BITS)
+  {
+    psim_load_patterns(ps, pat, first);
+    psim_good_eval(ps);
+    psim_store_outputs(ps, pat, first);
+    for (b = 0; b < nbridges; b++)
+    {
+      if (detected[b])
+        continue;
+      ninj = bridge_inject(ps, bridges[b], inj);
+      if (psim_propagate(ps, inj, ninj))
+        detected[b] = TRUE;
+    }
+  }
+  psim_free(ps);
+
+  UNLINK_DETECTED(undetected_blist, bridges, detected, nbridges);
+  free(bridges);
+  free(detected);
+  return (undetected_blist);
+}
+
+void write_bridge_output(circuit_t *ckt, pattern_t *pat, bridge_list_t *blist,
+                         int num_bridges, FILE *out_file)
+{
+  bridge_list_t *ptr;
+  int count;
+
+  write_patterns(ckt, pat, out_file);
+  fprintf(out_file, "\nList of Undetected Bridging Faults:\n");
+  if (blist == (bridge_list_t *)NULL)
+    fprintf(out_file, "(Empty)\n");
+  count = 0;
+  for (ptr = blist; ptr != (bridge_list_t *)NULL; ptr = ptr->next)
+  {
+    count++;
+    fprintf(out_file, "Bridge %s %s %s\n", bridge_name[ptr->type],
+            ckt->gate[ptr->gate_a].name, ckt->gate[ptr->gate_b].name);
+  }
+  fprintf(out_file, "\nTotal Number of Bridging Faults = %d\n", num_bridges);
+  fprintf(out_file, "Number of Undetected Bridging Faults = %d\n", count);
+  if (num_bridges > 0)
+    fprintf(out_file, "Bridging Fault Coverage = %d.%d%%\n\n",
+            ((num_bridges - count) * 100) / num_bridges,
+            ((num_bridges - count) * 1000 / num_bridges) % 10);
+}
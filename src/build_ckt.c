@@ -57,6 +57,9 @@ static int    NumOfGate = 0;
 static int    NumOfPI = 0;
 static int    NumOfPO = 0;
 static int    CktMaxLevel = UnLevel;  /* unnecessary right now */
+static Gate_Struct_t **LatchPPI = NULL;  /* latch outputs (pseudo PIs) */
+static Gate_Struct_t **LatchPPO = NULL;  /* latch inputs (pseudo POs) */
+static int    NumOfLatch = 0;
 
 /* following three memory acllocate functions are the same as those in 
    standard C functions except that print out error message and assert
@@ -111,6 +114,7 @@ void Add_Gate(const Gate_Info_t * GateInfo ){
   CurrGateStruct->FaninStruct = NULL;
   CurrGateStruct->FanoutStruct = NULL;
   CurrGateStruct->level = UnLevel; 
+  CurrGateStruct->index = UnLevel;     /* stays so if never levelized */
   /*set gate name to the name of output node of the gate */
   CurrGateStruct->name = strdup(GateInfo->NameOfNode[GateInfo->NumOfNode-1]);
   /* loop each node (signal) of the gate */
@@ -208,6 +212,30 @@ void Add_Gate(const Gate_Info_t * GateInfo ){
 /* primary input list and primary output list should be here */
 }
 
+/* call add_latch() for each latch. The circuit is handled as full-scan:
+ *  the latch output "out" is added as a pseudo primary input and the latch
+ *  input "in" as a pseudo primary output. Both are remembered so that the
+ *  pairs can be found in ckt.ppi[]/ckt.ppo[] after Build_Ckt().
+ */
+void Add_Latch(char *in, char *out){
+  Gate_Info_t GateInfo;
+
+  GateInfo.NumOfNode = 1;
+  LatchPPI = (Gate_Struct_t **) reallocm(LatchPPI,
+			     (NumOfLatch+1)*sizeof(Gate_Struct_t *));
+  LatchPPO = (Gate_Struct_t **) reallocm(LatchPPO,
+			     (NumOfLatch+1)*sizeof(Gate_Struct_t *));
+  GateInfo.GateType = PI;
+  GateInfo.NameOfNode = &out;
+  Add_Gate(&GateInfo);
+  LatchPPI[NumOfLatch] = ListPIStart->GateStruct;
+  GateInfo.GateType = PO;
+  GateInfo.NameOfNode = &in;
+  Add_Gate(&GateInfo);
+  LatchPPO[NumOfLatch] = ListPOStart->GateStruct;
+  NumOfLatch++;
+}
+
 /* levelize each gate, start from PO. Algorithm is that looking fanins of the
  *  gate and level of this gate is the maximum of level of fanins plus one. If
  *  any fanin has no level, unlevelized fanis will be evaluated before evaluate 
@@ -405,6 +433,17 @@ static void Convert_Ckt(Circuit_Struct_t * ckt_t){
   ckt_t->ngates=NumOfGate;
   ckt_t->npi=NumOfPI;
   ckt_t->npo=NumOfPO;
+  ckt_t->nlatch=NumOfLatch;
+  if ( NumOfLatch ){
+    ckt_t->ppi = (int*)callocm(NumOfLatch,sizeof(int));
+    ckt_t->ppo = (int*)callocm(NumOfLatch,sizeof(int));
+  }
+  for ( i=0; i<NumOfLatch; i++ ){
+    ckt_t->ppi[i] = LatchPPI[i]->index;
+    ckt_t->ppo[i] = LatchPPO[i]->index;
+  }
+  free(LatchPPI);
+  free(LatchPPO);
   ListLevelIter = ListLevelStart;
   count=0;
 
@@ -413,7 +452,7 @@ static void Convert_Ckt(Circuit_Struct_t * ckt_t){
       ckt_t->gate[count].name = ListLevelIter->GateStruct[i]->name;
       ckt_t->gate[count].type = ListLevelIter->GateStruct[i]->GateType;
       ckt_t->gate[count].index = ListLevelIter->GateStruct[i]->index;
-      ckt_t->gate[count].num_fanout=ListLevelIter->GateStruct[i]->NumOfFanout;
+      ckt_t->gate[count].num_fanout=0;
       if( ListLevelIter->GateStruct[i]->NumOfFanout ){
 	ckt_t->gate[count].fanout =
 	  (int*)callocm(ListLevelIter->GateStruct[i]->NumOfFanout,sizeof(int));
@@ -425,8 +464,11 @@ static void Convert_Ckt(Circuit_Struct_t * ckt_t){
 	  ListLevelIter->GateStruct[i]->FaninStruct[j]->index;
       }
       for (;j<MAX_GATE_FANIN;j++) ckt_t->gate[count].fanin[j]=UnLevel;
+      /* fanouts that reach no primary output were not levelized; drop them */
       for (j=0; j<ListLevelIter->GateStruct[i]->NumOfFanout;j++){
-	ckt_t->gate[count].fanout[j] = 
+	if ( ListLevelIter->GateStruct[i]->FanoutStruct[j]->index == UnLevel )
+	  continue;
+	ckt_t->gate[count].fanout[ckt_t->gate[count].num_fanout++] = 
 	  ListLevelIter->GateStruct[i]->FanoutStruct[j]->index;
       }
 
@@ -472,6 +514,43 @@ void Build_Ckt(){
 }
 
 
+/* hashed name lookup over ckt.gate[]. A PO gate carries the name of the net
+ * it observes, so a name may belong to two gates; "po" selects which one.
+ * The table is built on the first call.
+ */
+static int  *NameTable = NULL;
+static int   NameTableSize = 0;
+
+static unsigned int Hash_Name(const char *name){
+  unsigned int h = 2166136261u;
+  while (*name) h = (h ^ (unsigned char)*name++) * 16777619u;
+  return h;
+}
+
+int Find_Gate(const char *name, int po){
+  unsigned int h;
+  int i;
+
+  if (NameTable == NULL){
+    for (NameTableSize=64; NameTableSize < 2*ckt.ngates; NameTableSize*=2);
+    NameTable = (int *) mallocm(NameTableSize*sizeof(int));
+    for (i=0;i<NameTableSize;i++) NameTable[i] = -1;
+    for (i=0;i<ckt.ngates;i++){
+      h = Hash_Name(ckt.gate[i].name) & (NameTableSize-1);
+      while (NameTable[h] >= 0) h = (h+1) & (NameTableSize-1);
+      NameTable[h] = i;
+    }
+  }
+  h = Hash_Name(name) & (NameTableSize-1);
+  while ((i=NameTable[h]) >= 0){
+    if ( strcmp(ckt.gate[i].name,name)==0 && ((ckt.gate[i].type==PO) == (po!=0)) )
+      return i;
+    h = (h+1) & (NameTableSize-1);
+  }
+  return -1;
+}
+
+
 /* following code is to test this program */
 #ifdef SELFTEST_BUILD_CKT
 int main(int argv, char **argc){
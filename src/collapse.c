@@ -0,0 +1,326 @@
+#include "project.h"
+#include "psim.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*
+ * Structural equivalence collapsing.
+ *
+ * Two faults are equivalent when they leave the same faulty circuit, so
+ * every pattern, in three-valued simulation as well, detects both or
+ * neither.  Three local rules cover the usual cases:
+ *
+ *   - a fanout-free line: the output fault of a gate with a single fanout
+ *     is the fault of that fanout's input, e.g. of a PO or of the input of
+ *     an AND;
+ *   - an INV or BUF: its input s-a-v is its output s-a-!v or s-a-v;
+ *   - an AND, NAND, OR or NOR: an input stuck at the controlling value is
+ *     the output stuck at the controlled value.
+ *
+ * The universe leaves out the inputs of INV and BUF and the controlling
+ * input faults.  Such a fault still links classes through its line when
+ * the driver is fanout-free, so a chain of inverters becomes one class per
+ * value.  Classes are kept in a union-find over the positions of the list.
+ * The first fault of each class is simulated, and its outcome is copied
+ * to the others afterwards.
+ *
+ * Dominance goes further, but only one way.  Every test for an input of
+ * an AND stuck at 1 also tests its output stuck at 1, since the faulty
+ * output values are the same, so the output fault need not be simulated:
+ * it is reported detected when an input fault is (likewise NAND output
+ * s-a-0, OR output s-a-0 and NOR output s-a-1).  The output fault may
+ * still be detected by patterns that detect neither input fault, so the
+ * coverage is a lower bound.  After both steps, what is simulated is the
+ * checkpoint faults (primary inputs and fanout branches) and the fanout
+ * stems.  A stem is not implied by its branches pattern by pattern, as
+ * reconvergence may mask it, so it stays.  Dominance holds per pattern
+ * only: with latches or a MISR, it breaks, so it is not applied there.
+ */
+
+#define FAULT_SLOTS (2 * (MAX_GATE_FANIN + 1)) /* pins times values */
+
+/* position of the fault on pin k (-1 for the output) of gate g stuck at
+   v, -1 if the list does not hold it */
+#define SLOT(g, k, v) slot[(size_t)(g) * FAULT_SLOTS + 2 * ((k) + 1) + (v)]
+
+static int find(int *parent, int f)
+{
+  while (parent[f] != f)
+  {
+    parent[f] = parent[parent[f]];
+    f = parent[f];
+  }
+  return (f);
+}
+
+/* the class of the lower position is kept, so the list order is too */
+static void join(int *parent, int a, int b)
+{
+  if (a < 0 || b < 0)
+    return;
+  a = find(parent, a);
+  b = find(parent, b);
+  if (a < b)
+    parent[b] = a;
+  else
+    parent[a] = b;
+}
+
+/* TRUE if the line into pin k of gate g is the only fanout of its driver */
+static int fanout_free(circuit_t *ckt, int g, int k)
+{
+  int d = ckt->gate[g].fanin[k], j;
+
+  if (ckt->gate[d].num_fanout != 1)
+    return (FALSE);
+  /* both inputs tied to one driver are a fanout of two */
+  for (j = 0; j < MAX_GATE_FANIN; j++)
+  {
+    if (j != k && ckt->gate[g].fanin[j] == d)
+      return (FALSE);
+  }
+  return (TRUE);
+}
+
+/* a fault in the list equivalent to pin k of gate g stuck at v, -1 if none */
+static int line_fault(circuit_t *ckt, int *slot, int g, int k, int v)
+{
+  if (SLOT(g, k, v) >= 0)
+    return (SLOT(g, k, v));
+  if (fanout_free(ckt, g, k))
+    return (SLOT(ckt->gate[g].fanin[k], -1, v));
+  return (-1);
+}
+
+static int pointer_compare(const void *a, const void *b)
+{
+  uintptr_t pa = (uintptr_t)*(fault_list_t *const *)a;
+  uintptr_t pb = (uintptr_t)*(fault_list_t *const *)b;
+
+  return ((pa < pb) ? -1 : (pa > pb) ? 1 : 0);
+}
+
+/*************************************************************************
+
+Function:  collapse_faults
+
+Purpose:  Saves flist in cl and squeezes it down to the first fault of
+every equivalence class (see above), in list order.  With "dominance"
+set, the classes implied by dominance are left out as well.  The faults
+left out stay allocated for expand_faults().
+
+Return:  List of the faults to simulate.
+
+*************************************************************************/
+
+fault_list_t *collapse_faults(circuit_t *ckt, fault_list_t *flist,
+                              int dominance, collapse_t *cl)
+{
+  fault_list_t *fptr, **tail;
+  char *dropped;
+  int *slot, *parent, *dom, nfaults, f, g, k, v, out, x, n;
+
+  cl->faults = psim_fault_array(flist, &nfaults);
+  cl->nfaults = nfaults;
+  cl->rep = (int *)malloc((nfaults + 1) * sizeof(int));
+  slot = (int *)malloc((size_t)ckt->ngates * FAULT_SLOTS * sizeof(int));
+  for (f = 0; f < ckt->ngates * FAULT_SLOTS; f++)
+    slot[f] = -1;
+  parent = cl->rep;
+  for (f = 0; f < nfaults; f++)
+  {
+    fptr = cl->faults[f];
+    parent[f] = f;
+    SLOT(fptr->gate_index, fptr->input_index, fptr->type) = f;
+  }
+
+  for (g = 0; g < ckt->ngates; g++)
+  {
+    if (ckt->gate[g].type == PI || ckt->gate[g].type == PO_GND ||
+        ckt->gate[g].type == PO_VCC)
+      continue;
+    for (k = 0; k < MAX_GATE_FANIN; k++)
+    {
+      if (ckt->gate[g].fanin[k] < 0)
+        continue;
+      if (fanout_free(ckt, g, k))
+      {
+        for (v = S_A_0; v <= S_A_1; v++)
+          join(parent, SLOT(g, k, v), SLOT(ckt->gate[g].fanin[k], -1, v));
+      }
+      switch (ckt->gate[g].type)
+      {
+      case AND:
+        join(parent, line_fault(ckt, slot, g, k, S_A_0), SLOT(g, -1, S_A_0));
+        break;
+      case NAND:
+        join(parent, line_fault(ckt, slot, g, k, S_A_0), SLOT(g, -1, S_A_1));
+        break;
+      case OR:
+        join(parent, line_fault(ckt, slot, g, k, S_A_1), SLOT(g, -1, S_A_1));
+        break;
+      case NOR:
+        join(parent, line_fault(ckt, slot, g, k, S_A_1), SLOT(g, -1, S_A_0));
+        break;
+      case INV:
+      case BUF:
+        for (v = S_A_0; v <= S_A_1; v++)
+        {
+          out = (ckt->gate[g].type == INV) ? !v : v;
+          join(parent, line_fault(ckt, slot, g, k, v), SLOT(g, -1, out));
+        }
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  /* rep[f] is the first fault of the class of f */
+  for (f = 0; f < nfaults; f++)
+    cl->rep[f] = find(parent, f);
+
+  /* the output fault at the non-controlled value is implied by the input
+     faults at the non-controlling value */
+  dropped = (char *)calloc(nfaults + 1, sizeof(char));
+  cl->derived = (int *)malloc((ckt->ngates + 1) * sizeof(int));
+  cl->dominated = (int *)malloc((size_t)(ckt->ngates + 1) * MAX_GATE_FANIN *
+                                sizeof(int));
+  cl->nderived = cl->ndropped = 0;
+  for (g = 0; dominance && g < ckt->ngates; g++)
+  {
+    switch (ckt->gate[g].type)
+    {
+    case AND:
+      out = SLOT(g, -1, S_A_1);
+      v = S_A_1;
+      break;
+    case NAND:
+      out = SLOT(g, -1, S_A_0);
+      v = S_A_1;
+      break;
+    case OR:
+      out = SLOT(g, -1, S_A_0);
+      v = S_A_0;
+      break;
+    case NOR:
+      out = SLOT(g, -1, S_A_1);
+      v = S_A_0;
+      break;
+    default:
+      out = -1;
+      break;
+    }
+    if (out < 0)
+      continue;
+    out = cl->rep[out];
+    dom = &cl->dominated[(size_t)cl->nderived * MAX_GATE_FANIN];
+    for (n = 0, k = 0; k < MAX_GATE_FANIN; k++)
+    {
+      dom[k] = -1;
+      if (ckt->gate[g].fanin[k] < 0 ||
+          (x = line_fault(ckt, slot, g, k, v)) < 0 || cl->rep[x] == out)
+        continue;
+      dom[k] = cl->rep[x];
+      n++;
+    }
+    if (n == 0)
+      continue;
+    cl->derived[cl->nderived++] = out;
+    if (!dropped[out])
+      cl->ndropped++;
+    dropped[out] = TRUE;
+  }
+  free(slot);
+
+  tail = &flist;
+  for (cl->nclasses = 0, f = 0; f < nfaults; f++)
+  {
+    if (cl->rep[f] == f && !dropped[f])
+    {
+      *tail = cl->faults[f];
+      tail = &cl->faults[f]->next;
+      cl->nclasses++;
+    }
+  }
+  *tail = (fault_list_t *)NULL;
+  free(dropped);
+  return (flist);
+}
+
+/*************************************************************************
+
+Function:  expand_faults
+
+Purpose:  Undoes collapse_faults() for a list of simulated faults: every
+fault whose class representative is in flist is linked in, in the order
+of the uncollapsed list.  When flist holds the undetected faults
+("undetected" set), the classes left out by dominance are linked in too,
+unless a class they dominate was detected, and the detect_index of every
+representative is copied to its class.  Their detect_index is the first
+detection among the classes they dominate, which may be later than their
+own first detection.
+
+Return:  The expanded list.
+
+*************************************************************************/
+
+fault_list_t *expand_faults(collapse_t *cl, fault_list_t *flist,
+                            int undetected)
+{
+  fault_list_t *fptr, **sorted, **found, **tail;
+  char *listed;
+  int *dom, n, f, d, k, first;
+
+  sorted = psim_fault_array(flist, &n);
+  qsort(sorted, n, sizeof(fault_list_t *), pointer_compare);
+
+  /* the representatives in flist */
+  listed = (char *)calloc(cl->nfaults + 1, sizeof(char));
+  for (f = 0; f < cl->nfaults; f++)
+  {
+    if (cl->rep[f] != f)
+      continue;
+    found = (fault_list_t **)bsearch(&cl->faults[f], sorted, n,
+                                     sizeof(fault_list_t *), pointer_compare);
+    listed[f] = (found != NULL);
+  }
+
+  /* gate order: a dominated class is settled before it is used */
+  for (d = 0; undetected && d < cl->nderived; d++)
+    cl->faults[cl->derived[d]]->detect_index = -1;
+  for (d = 0; undetected && d < cl->nderived; d++)
+  {
+    dom = &cl->dominated[(size_t)d * MAX_GATE_FANIN];
+    fptr = cl->faults[cl->derived[d]];
+    for (k = 0; k < MAX_GATE_FANIN; k++)
+    {
+      if (dom[k] < 0 || (first = cl->faults[dom[k]]->detect_index) < 0)
+        continue;
+      if (fptr->detect_index < 0 || fptr->detect_index > first)
+        fptr->detect_index = first;
+    }
+  }
+  for (d = 0; undetected && d < cl->nderived; d++)
+    listed[cl->derived[d]] = (cl->faults[cl->derived[d]]->detect_index < 0);
+
+  tail = &flist;
+  for (f = 0; f < cl->nfaults; f++)
+  {
+    if (undetected)
+      cl->faults[f]->detect_index = cl->faults[cl->rep[f]]->detect_index;
+    if (listed[cl->rep[f]])
+    {
+      *tail = cl->faults[f];
+      tail = &cl->faults[f]->next;
+    }
+  }
+  *tail = (fault_list_t *)NULL;
+  free(sorted);
+  free(listed);
+  return (flist);
+}
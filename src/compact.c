@@ -0,0 +1,257 @@
+#include "project.h"
+#include "psim.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*
+ * Static test compaction.
+ *
+ * The patterns are fault simulated with dropping in reverse order; a
+ * pattern that is the first, in that order, to detect some fault is
+ * essential and every other pattern is removed.  Passes alternate
+ * direction on the remaining patterns until one removes nothing.  A greedy
+ * set cover over per-pattern detection bitmaps may follow.  The detected
+ * fault set never changes.
+ */
+
+#define COMPACT_PASSES 8 /* most dropping passes */
+
+/* one dropping pass over the patterns idx[0..n-1] in that order; marks in
+   credit[] the patterns that detect some fault first and sets the
+   detect_index of the faults to positions in idx[] */
+static void credit_pass(psim_t *ps, pattern_t *pat, pattern_t *view,
+                        int *idx, int n, fault_list_t **faults, int nfaults,
+                        char *detected, char *credit)
+{
+  inject_t inj;
+  word_t d;
+  int first, f, j;
+
+  for (j = 0; j < n; j++)
+  {
+    view->in[j] = pat->in[idx[j]];
+    view->out[j] = pat->out[idx[j]];
+  }
+  view->len = n;
+  memset(detected, 0, nfaults);
+  for (first = 0; first < n; first += WORD_BITS)
+  {
+    psim_load_patterns(ps, view, first);
+    psim_good_eval(ps);
+    psim_store_outputs(ps, view, first);
+    for (f = 0; f < nfaults; f++)
+    {
+      if (detected[f])
+        continue;
+      psim_fault_inject(faults[f], &inj);
+      if ((d = psim_propagate(ps, &inj, 1)) != 0)
+      {
+        detected[f] = TRUE;
+        credit[idx[first + lowest_lane(d)]] = TRUE;
+        faults[f]->detect_index = first + lowest_lane(d);
+      }
+    }
+  }
+}
+
+/* greedy set cover of the detected faults by the patterns idx[0..n-1];
+   faults detected by a single pattern force that pattern first */
+static void greedy_cover(psim_t *ps, pattern_t *pat, pattern_t *view,
+                         int *idx, int n, fault_list_t **faults, int nfaults,
+                         char *detected, char *keep)
+{
+  inject_t inj;
+  word_t d, *bits, *covered;
+  int *col, *count, *ndet, *only;
+  int ncols, nwords, first, f, c, j, p, best, w, left;
+
+  col = (int *)malloc((nfaults + 1) * sizeof(int));
+  for (ncols = 0, f = 0; f < nfaults; f++)
+    col[f] = detected[f] ? ncols++ : -1;
+  nwords = (ncols + WORD_BITS - 1) / WORD_BITS;
+  bits = (word_t *)calloc((size_t)n * nwords + 1, sizeof(word_t));
+  covered = (word_t *)calloc(nwords + 1, sizeof(word_t));
+  count = (int *)calloc(n + 1, sizeof(int));
+  ndet = (int *)calloc(ncols + 1, sizeof(int));
+  only = (int *)malloc((ncols + 1) * sizeof(int));
+
+  /* detection bitmaps, no dropping */
+  for (j = 0; j < n; j++)
+  {
+    view->in[j] = pat->in[idx[j]];
+    view->out[j] = pat->out[idx[j]];
+  }
+  view->len = n;
+  for (first = 0; first < n; first += WORD_BITS)
+  {
+    psim_load_patterns(ps, view, first);
+    psim_good_eval(ps);
+    for (f = 0; f < nfaults; f++)
+    {
+      if ((c = col[f]) < 0)
+        continue;
+      psim_fault_inject(faults[f], &inj);
+      for (d = psim_propagate(ps, &inj, 1); d != 0; d &= d - 1)
+      {
+        p = first + lowest_lane(d);
+        bits[(size_t)p * nwords + c / WORD_BITS] |= LANE(c % WORD_BITS);
+        count[p]++;
+        ndet[c]++;
+        only[c] = p;
+      }
+    }
+  }
+
+  /* essential patterns */
+  for (p = 0; p < n; p++)
+    keep[p] = FALSE;
+  for (c = 0; c < ncols; c++)
+  {
+    if (ndet[c] == 1)
+      keep[only[c]] = TRUE;
+  }
+  left = ncols;
+  for (p = 0; p < n; p++)
+  {
+    if (!keep[p])
+      continue;
+    for (w = 0; w < nwords; w++)
+    {
+      left -= popcount(bits[(size_t)p * nwords + w] & ~covered[w]);
+      covered[w] |= bits[(size_t)p * nwords + w];
+    }
+  }
+
+  /* lazy greedy: counts only go down, so a recounted maximum is exact */
+  while (left > 0)
+  {
+    best = -1;
+    for (p = 0; p < n; p++)
+    {
+      if (!keep[p] && (best < 0 || count[p] > count[best]))
+        best = p;
+    }
+    assert(best >= 0 && count[best] > 0);
+    for (c = 0, w = 0; w < nwords; w++)
+      c += popcount(bits[(size_t)best * nwords + w] & ~covered[w]);
+    if (c < count[best])
+    {
+      count[best] = c;
+      continue;
+    }
+    keep[best] = TRUE;
+    left -= c;
+    for (w = 0; w < nwords; w++)
+      covered[w] |= bits[(size_t)best * nwords + w];
+  }
+
+  free(col);
+  free(bits);
+  free(covered);
+  free(count);
+  free(ndet);
+  free(only);
+}
+
+/*************************************************************************
+
+Function:  compact_patterns
+
+Purpose:  Removes patterns from pat without losing any detection (see
+above), with a greedy set cover at the end when "greedy" is set.  The
+remaining patterns keep their order and pat.out[][] is filled for them.
+
+Return:  List of faults that remain undetected, in their original order.
+
+*************************************************************************/
+
+fault_list_t *compact_patterns(circuit_t *ckt, pattern_t *pat,
+                               fault_list_t *undetected_flist, int greedy)
+{
+  psim_t *ps;
+  pattern_t *view;
+  fault_list_t **faults;
+  char *detected, *keep, *credit;
+  int *idx, nfaults, n, pass, i, j, removed;
+
+  faults = psim_fault_array(undetected_flist, &nfaults);
+  detected = (char *)calloc(nfaults + 1, sizeof(char));
+  view = (pattern_t *)malloc(sizeof(pattern_t));
+  idx = (int *)malloc((pat->len + 1) * sizeof(int));
+  keep = (char *)malloc(pat->len + 1);
+  credit = (char *)malloc(pat->len + 1);
+  memset(keep, TRUE, pat->len);
+
+  ps = psim_create(ckt);
+  removed = 1;
+  for (pass = 0; pass < COMPACT_PASSES && removed > 0; pass++)
+  {
+    /* reverse order first, then alternate */
+    n = 0;
+    for (i = 0; i < pat->len; i++)
+    {
+      j = (pass % 2 == 0) ? pat->len - 1 - i : i;
+      if (keep[j])
+        idx[n++] = j;
+      credit[i] = FALSE;
+    }
+    credit_pass(ps, pat, view, idx, n, faults, nfaults, detected, credit);
+    for (removed = 0, i = 0; i < pat->len; i++)
+    {
+      if (keep[i] && !credit[i])
+        removed++;
+      keep[i] = credit[i];
+    }
+  }
+  if (greedy)
+  {
+    for (n = 0, i = 0; i < pat->len; i++)
+    {
+      if (keep[i])
+        idx[n++] = i;
+    }
+    greedy_cover(ps, pat, view, idx, n, faults, nfaults, detected, credit);
+    for (i = 0; i < pat->len; i++)
+      keep[i] = FALSE;
+    for (j = 0; j < n; j++)
+      keep[idx[j]] = credit[j];
+  }
+
+  /* first detections within the final pattern list */
+  for (n = 0, i = 0; i < pat->len; i++)
+  {
+    if (keep[i])
+      idx[n++] = i;
+  }
+  credit_pass(ps, pat, view, idx, n, faults, nfaults, detected, credit);
+  psim_free(ps);
+
+  /* squeeze the pattern list */
+  for (n = 0, i = 0; i < pat->len; i++)
+  {
+    if (keep[i])
+    {
+      pat->in[n] = pat->in[i];
+      pat->out[n] = pat->out[i];
+      n++;
+    }
+    else
+    {
+      free(pat->in[i]);
+      free(pat->out[i]);
+    }
+  }
+  pat->len = n;
+
+  undetected_flist = psim_unlink_detected(faults, detected, nfaults);
+  free(faults);
+  free(detected);
+  free(view);
+  free(idx);
+  free(keep);
+  free(credit);
+  return (undetected_flist);
+}
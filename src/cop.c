@@ -0,0 +1,377 @@
+#include "project.h"
+#include "psim.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+
+/*
+ * COP testability measures and weighted random pattern generation.
+ *
+ * c1[g] is the probability that gate g is 1 under random inputs and obs[g]
+ * the probability that a change on its output reaches an observed primary
+ * output.  Both are computed in one linear pass each, treating signals as
+ * independent.  sens[g * MAX_GATE_FANIN + k] is the probability that input
+ * k of gate g is sensitized, i.e. that its other input is non-controlling.
+ * The detection probability of a stuck-at fault is the probability of
+ * exciting it times the observability of its line.
+ */
+
+#define WEIGHT_STEPS 16      /* input weights are multiples of 1/16 */
+#define WRP_WINDOW 1024      /* patterns per weight set in the objective */
+#define WRP_STALL 16         /* blocks per check of the detection yield */
+#define WRP_YIELD 100        /* reweight when a check catches < 1/100 of
+                                the faults left */
+#define WRP_SWEEPS 2         /* passes of the weight optimization */
+
+/*************************************************************************
+
+Function:  cop_controllability
+
+Purpose:  Fills c1[] from the 1-probabilities of the primary inputs
+(pi_c1[] in pattern file order), in gate order.
+
+*************************************************************************/
+
+void cop_controllability(circuit_t *ckt, double *pi_c1, double *c1)
+{
+  gate_t *g;
+  double a, b;
+  int i;
+
+  for (i = 0; i < ckt->npi; i++)
+  {
+    if (ckt->pi[i] >= 0)
+      c1[ckt->pi[i]] = pi_c1[i];
+  }
+  for (i = 0; i < ckt->ngates; i++)
+  {
+    g = &ckt->gate[i];
+    if (g->type == PI)
+      continue;
+    a = (g->fanin[0] >= 0) ? c1[g->fanin[0]] : 0.0;
+    b = (g->fanin[1] >= 0) ? c1[g->fanin[1]] : 0.0;
+    switch (g->type)
+    {
+    case AND:
+      c1[i] = a * b;
+      break;
+    case NAND:
+      c1[i] = 1.0 - a * b;
+      break;
+    case OR:
+      c1[i] = 1.0 - (1.0 - a) * (1.0 - b);
+      break;
+    case NOR:
+      c1[i] = (1.0 - a) * (1.0 - b);
+      break;
+    case INV:
+      c1[i] = 1.0 - a;
+      break;
+    case BUF:
+    case PO:
+      c1[i] = a;
+      break;
+    case PO_GND:
+      c1[i] = 0.0;
+      break;
+    case PO_VCC:
+      c1[i] = 1.0;
+      break;
+    default:
+      assert(0);
+    }
+  }
+}
+
+/* fills sens[] from c1[]: the probability that each gate input passes a
+   change to the gate output */
+void cop_sensitivity(circuit_t *ckt, double *c1, double *sens)
+{
+  gate_t *g;
+  int i, k;
+
+  for (i = 0; i < ckt->ngates; i++)
+  {
+    g = &ckt->gate[i];
+    for (k = 0; k < MAX_GATE_FANIN; k++)
+    {
+      switch (g->type)
+      {
+      case AND:
+      case NAND:
+        sens[i * MAX_GATE_FANIN + k] = c1[g->fanin[1 - k]];
+        break;
+      case OR:
+      case NOR:
+        sens[i * MAX_GATE_FANIN + k] = 1.0 - c1[g->fanin[1 - k]];
+        break;
+      default:
+        sens[i * MAX_GATE_FANIN + k] = 1.0;
+      }
+    }
+  }
+}
+
+/*************************************************************************
+
+Function:  cop_observability
+
+Purpose:  Fills obs[] in reverse gate order from the input sensitization
+probabilities.  The observed primary outputs have observability 1; a
+fanout stem is observed unless all of its branches are blocked.
+
+*************************************************************************/
+
+void cop_observability(circuit_t *ckt, double *sens, double *obs)
+{
+  gate_t *g, *h;
+  double blocked;
+  int i, j, k;
+
+  for (i = 0; i < ckt->ngates; i++)
+    obs[i] = 0.0;
+  for (i = 0; i < ckt->npo; i++)
+  {
+    if (ckt->po_mask == NULL || !ckt->po_mask[i])
+      obs[ckt->po[i]] = 1.0;
+  }
+  for (i = ckt->ngates - 1; i >= 0; i--)
+  {
+    g = &ckt->gate[i];
+    if (g->type == PO)
+      continue;
+    blocked = 1.0;
+    for (j = 0; j < g->num_fanout; j++)
+    {
+      h = &ckt->gate[g->fanout[j]];
+      for (k = 0; k < MAX_GATE_FANIN; k++)
+      {
+        if (h->fanin[k] == i)
+          blocked *= 1.0 - obs[g->fanout[j]] *
+                               sens[g->fanout[j] * MAX_GATE_FANIN + k];
+      }
+    }
+    obs[i] = 1.0 - blocked;
+  }
+}
+
+/* probability that a random pattern detects fault *fptr */
+double cop_detect_prob(circuit_t *ckt, double *c1, double *sens, double *obs,
+                       fault_list_t *fptr)
+{
+  double p1, o;
+  int i = fptr->gate_index;
+
+  if (fptr->input_index < 0)
+  {
+    p1 = c1[i];
+    o = obs[i];
+  }
+  else
+  {
+    p1 = c1[ckt->gate[i].fanin[fptr->input_index]];
+    o = obs[i] * sens[i * MAX_GATE_FANIN + fptr->input_index];
+  }
+  return ((fptr->type == S_A_0) ? p1 * o : (1.0 - p1) * o);
+}
+
+/* expected number of faults[] that WRP_WINDOW patterns detect */
+static double expected_detections(circuit_t *ckt, double *pi_c1,
+                                   fault_list_t **faults, char *detected,
+                                   int nfaults, double *c1, double *sens,
+                                   double *obs)
+{
+  double sum, p;
+  int f;
+
+  cop_controllability(ckt, pi_c1, c1);
+  cop_sensitivity(ckt, c1, sens);
+  cop_observability(ckt, sens, obs);
+  sum = 0.0;
+  for (f = 0; f < nfaults; f++)
+  {
+    if (detected[f])
+      continue;
+    p = cop_detect_prob(ckt, c1, sens, obs, faults[f]);
+    if (p >= 1.0)
+      sum += 1.0;
+    else
+      sum += 1.0 - exp(WRP_WINDOW * log1p(-p));
+  }
+  return (sum);
+}
+
+/*************************************************************************
+
+Function:  cop_optimize_weights
+
+Purpose:  Chooses the 1-probability of every primary input, in steps of
+1/WEIGHT_STEPS, to maximize the expected number of the not yet detected
+faults caught by the next WRP_WINDOW patterns.  Coordinate ascent from
+the current weights: each input is moved one step up or down while that
+improves the objective.
+
+*************************************************************************/
+
+void cop_optimize_weights(circuit_t *ckt, fault_list_t **faults,
+                          char *detected, int nfaults, int *weight)
+{
+  double *pi_c1, *c1, *sens, *obs, best, val;
+  int i, d, sweep, improved;
+
+  pi_c1 = (double *)malloc((ckt->npi + 1) * sizeof(double));
+  c1 = (double *)malloc(ckt->ngates * sizeof(double));
+  sens = (double *)malloc(ckt->ngates * MAX_GATE_FANIN * sizeof(double));
+  obs = (double *)malloc(ckt->ngates * sizeof(double));
+  for (i = 0; i < ckt->npi; i++)
+    pi_c1[i] = (double)weight[i] / WEIGHT_STEPS;
+  best = expected_detections(ckt, pi_c1, faults, detected, nfaults, c1, sens,
+                             obs);
+  for (sweep = 0, improved = TRUE; sweep < WRP_SWEEPS && improved; sweep++)
+  {
+    improved = FALSE;
+    for (i = 0; i < ckt->npi; i++)
+    {
+      if (ckt->pi[i] < 0)
+        continue;
+      for (d = -1; d <= 1; d += 2)
+      {
+        while (weight[i] + d > 0 && weight[i] + d < WEIGHT_STEPS)
+        {
+          pi_c1[i] = (double)(weight[i] + d) / WEIGHT_STEPS;
+          val = expected_detections(ckt, pi_c1, faults, detected, nfaults,
+                                    c1, sens, obs);
+          if (val <= best)
+            break;
+          best = val;
+          weight[i] += d;
+          improved = TRUE;
+        }
+        pi_c1[i] = (double)weight[i] / WEIGHT_STEPS;
+      }
+    }
+  }
+  free(pi_c1);
+  free(c1);
+  free(sens);
+  free(obs);
+}
+
+/* WORD_BITS random bits, each 1 with probability weight / WEIGHT_STEPS */
+static word_t weighted_word(int weight, word_t *state)
+{
+  word_t w;
+  int j;
+
+  /* bit j of the weight decides between AND and OR with a fresh word */
+  for (w = 0, j = 0; j < 4; j++)
+  {
+    if (weight & (1 << j))
+      w |= psim_random(state);
+    else
+      w &= psim_random(state);
+  }
+  return (w);
+}
+
+/*************************************************************************
+
+Function:  weighted_random_simulate
+
+Purpose:  Generates up to npatterns weighted random patterns into pat and
+fault simulates them WORD_BITS at a time with fault dropping.  The first
+patterns are unweighted; whenever WRP_STALL blocks in a row catch fewer
+than 1/WRP_YIELD of the faults still undetected, the input weights are
+re-optimized with COP for the faults that are left.  Generation stops
+early once every fault is detected.
+
+pat.in[][] receives the patterns and pat.out[][] the fault-free outputs.
+
+Return:  List of faults that remain undetected, in their original order.
+
+*************************************************************************/
+
+fault_list_t *weighted_random_simulate(circuit_t *ckt, pattern_t *pat,
+                                       fault_list_t *undetected_flist,
+                                       int npatterns, unsigned long seed)
+{
+  psim_t *ps;
+  fault_list_t **faults;
+  char *detected;
+  inject_t inj;
+  int *weight, nfaults, nlive, f, i, p, first, n, nblocks, ncaught, nsets;
+  word_t state, w, d;
+
+  faults = psim_fault_array(undetected_flist, &nfaults);
+  detected = (char *)calloc(nfaults + 1, sizeof(char));
+  weight = (int *)malloc((ckt->npi + 1) * sizeof(int));
+  for (i = 0; i < ckt->npi; i++)
+    weight[i] = WEIGHT_STEPS / 2;
+
+  if (npatterns > MAX_PATTERNS)
+    npatterns = MAX_PATTERNS;
+  state = (seed != 0) ? seed : 1;
+  ps = psim_create(ckt);
+  nlive = nfaults;
+  nblocks = ncaught = 0;
+  nsets = 1;
+  pat->len = 0;
+  for (first = 0; first < npatterns && nlive > 0; first += WORD_BITS)
+  {
+    if (nblocks == WRP_STALL)
+    {
+      if (ncaught * WRP_YIELD < nlive)
+      {
+        cop_optimize_weights(ckt, faults, detected, nfaults, weight);
+        nsets++;
+      }
+      nblocks = ncaught = 0;
+    }
+    n = (npatterns - first < WORD_BITS) ? npatterns - first : WORD_BITS;
+    for (p = 0; p < n; p++)
+    {
+      pat->in[first + p] = (int *)malloc(ckt->npi * sizeof(int));
+      pat->out[first + p] = (int *)malloc(ckt->npo * sizeof(int));
+    }
+    for (i = 0; i < ckt->npi; i++)
+    {
+      w = weighted_word(weight[i], &state);
+      for (p = 0; p < n; p++)
+        pat->in[first + p][i] = (w >> p) & 1;
+      if (ckt->pi[i] < 0)
+        continue;
+      ps->one[ckt->pi[i]] = w;
+      ps->zero[ckt->pi[i]] = ~w;
+    }
+    ps->valid = (n == WORD_BITS) ? ALL_ONES : LANE(n) - 1;
+    pat->len = first + n;
+    psim_good_eval(ps);
+    psim_store_outputs(ps, pat, first);
+
+    nblocks++;
+    for (f = 0; f < nfaults; f++)
+    {
+      if (detected[f])
+        continue;
+      psim_fault_inject(faults[f], &inj);
+      if ((d = psim_propagate(ps, &inj, 1)) != 0)
+      {
+        detected[f] = TRUE;
+        faults[f]->detect_index = first + lowest_lane(d);
+        nlive--;
+        ncaught++;
+      }
+    }
+  }
+  psim_free(ps);
+  printf("Weighted random patterns = %d, weight sets = %d\n", pat->len, nsets);
+
+  undetected_flist = psim_unlink_detected(faults, detected, nfaults);
+  free(faults);
+  free(detected);
+  free(weight);
+  return (undetected_flist);
+}
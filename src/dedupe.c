@@ -0,0 +1,238 @@
+#include "project.h"
+#include "psim.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*
+ * Load-time pattern deduplication.
+ *
+ * Repeated rows of a pattern file detect exactly the faults of their first
+ * occurrence, so only that one is fault simulated.  With X-subsumption, a
+ * row with X inputs is also dropped when another row agrees with it on
+ * every input it sets: three-valued simulation is monotone, so refining an
+ * X to 0 or 1 never turns a binary value into X and the refining row
+ * detects every fault the X row detects.  The dropped rows get their good
+ * outputs back afterwards, so the output file does not change.
+ */
+
+#define ROW_KEPT -1     /* rep[] of a simulated row */
+#define ROW_SUBSUMED -2 /* rep[] of a row dropped by X-subsumption */
+
+/* FNV-1a over the input values of a row */
+static unsigned long long row_hash(int *row, int n)
+{
+  unsigned long long h = 14695981039346656037ULL;
+  int i;
+
+  for (i = 0; i < n; i++)
+  {
+    h ^= (unsigned long long)row[i];
+    h *= 1099511628211ULL;
+  }
+  return (h);
+}
+
+/* TRUE if row b sets every input row a sets, to the same value */
+static int row_refines(word_t *zero, word_t *one, int nwords, int a, int b)
+{
+  word_t *za = &zero[(size_t)a * nwords], *oa = &one[(size_t)a * nwords];
+  word_t *zb = &zero[(size_t)b * nwords], *ob = &one[(size_t)b * nwords];
+  int w;
+
+  for (w = 0; w < nwords; w++)
+  {
+    if ((za[w] & ~zb[w]) != 0 || (oa[w] & ~ob[w]) != 0)
+      return (FALSE);
+  }
+  return (TRUE);
+}
+
+/* mark in rep[] the kept rows that another kept row refines; quadratic in
+   the number of kept rows, but only rows with X inputs are candidates */
+static void mark_subsumed(circuit_t *ckt, pattern_t *pat, int *rep)
+{
+  word_t *zero, *one;
+  int *nx, nwords, a, b, i;
+
+  nwords = (ckt->npi + WORD_BITS - 1) / WORD_BITS;
+  zero = (word_t *)calloc((size_t)pat->len * nwords + 1, sizeof(word_t));
+  one = (word_t *)calloc((size_t)pat->len * nwords + 1, sizeof(word_t));
+  nx = (int *)calloc(pat->len + 1, sizeof(int));
+  for (a = 0; a < pat->len; a++)
+  {
+    if (rep[a] != ROW_KEPT)
+      continue;
+    for (i = 0; i < ckt->npi; i++)
+    {
+      if (pat->in[a][i] == LOGIC_0)
+        zero[(size_t)a * nwords + i / WORD_BITS] |= LANE(i % WORD_BITS);
+      else if (pat->in[a][i] == LOGIC_1)
+        one[(size_t)a * nwords + i / WORD_BITS] |= LANE(i % WORD_BITS);
+      else
+        nx[a]++;
+    }
+  }
+  /* distinct rows, so a refining row has fewer X inputs and the relation
+     has no cycles: every dropped row keeps a refining row */
+  for (a = 0; a < pat->len; a++)
+  {
+    if (rep[a] != ROW_KEPT || nx[a] == 0)
+      continue;
+    for (b = 0; b < pat->len; b++)
+    {
+      if (rep[b] == ROW_KEPT && nx[b] < nx[a] &&
+          row_refines(zero, one, nwords, a, b))
+      {
+        rep[a] = ROW_SUBSUMED;
+        break;
+      }
+    }
+  }
+  free(zero);
+  free(one);
+  free(nx);
+}
+
+/*************************************************************************
+
+Function:  dedupe_patterns
+
+Purpose:  Saves the pattern list in *all and squeezes pat down to the rows
+worth simulating (see above), in their order.  The rows are shared with
+*all, not copied.  Rows subsumed by X-refinement are dropped only when
+"xsubsume" is set.
+
+Return:  Map for expand_patterns(), one entry per row of *all.
+
+*************************************************************************/
+
+int *dedupe_patterns(circuit_t *ckt, pattern_t *pat, pattern_t *all,
+                     int xsubsume)
+{
+  int *rep, *table, size, mask, i, j, n;
+
+  *all = *pat;
+  rep = (int *)malloc((all->len + 1) * sizeof(int));
+  for (size = 2; size < 2 * all->len; size *= 2)
+    ;
+  mask = size - 1;
+  table = (int *)malloc(size * sizeof(int));
+  for (j = 0; j < size; j++)
+    table[j] = -1;
+
+  /* rep[i] is the first identical row, or ROW_KEPT */
+  for (i = 0; i < all->len; i++)
+  {
+    rep[i] = ROW_KEPT;
+    for (j = (int)(row_hash(all->in[i], ckt->npi) & mask); table[j] >= 0;
+         j = (j + 1) & mask)
+    {
+      if (memcmp(all->in[table[j]], all->in[i], ckt->npi * sizeof(int)) == 0)
+      {
+        rep[i] = table[j];
+        break;
+      }
+    }
+    if (rep[i] == ROW_KEPT)
+      table[j] = i;
+  }
+  free(table);
+  if (xsubsume)
+    mark_subsumed(ckt, all, rep);
+
+  for (n = 0, i = 0; i < all->len; i++)
+  {
+    if (rep[i] == ROW_KEPT)
+    {
+      pat->in[n] = all->in[i];
+      pat->out[n] = all->out[i];
+      n++;
+    }
+  }
+  pat->len = n;
+  return (rep);
+}
+
+/*************************************************************************
+
+Function:  dedupe_detect_index
+
+Purpose:  Turns the detect_index of faults[0..nfaults-1], counted in the
+deduplicated pat, into pattern numbers of *all.  Call before
+expand_patterns(), which frees rep.  A repeated row detects what its first
+occurrence detects, so the first detection does not move; a row dropped by
+X-subsumption may have detected a fault earlier than the row that refines
+it, which is not seen here.
+
+*************************************************************************/
+
+void dedupe_detect_index(fault_list_t **faults, int nfaults, pattern_t *all,
+                         int *rep)
+{
+  int *orig, f, i, n;
+
+  orig = (int *)malloc((all->len + 1) * sizeof(int));
+  for (n = 0, i = 0; i < all->len; i++)
+  {
+    if (rep[i] == ROW_KEPT)
+      orig[n++] = i;
+  }
+  for (f = 0; f < nfaults; f++)
+  {
+    if (faults[f]->detect_index >= 0)
+      faults[f]->detect_index = orig[faults[f]->detect_index];
+  }
+  free(orig);
+}
+
+/*************************************************************************
+
+Function:  expand_patterns
+
+Purpose:  Undoes dedupe_patterns() once pat.out[][] is filled: repeated
+rows copy the outputs of their first occurrence, subsumed rows are good
+simulated, and *all is copied back into pat.  Frees rep.
+
+*************************************************************************/
+
+void expand_patterns(circuit_t *ckt, pattern_t *pat, pattern_t *all, int *rep)
+{
+  psim_t *ps;
+  pattern_t *view;
+  int i, first;
+
+  view = (pattern_t *)malloc(sizeof(pattern_t));
+  view->len = 0;
+  for (i = 0; i < all->len; i++)
+  {
+    if (rep[i] == ROW_SUBSUMED)
+    {
+      view->in[view->len] = all->in[i];
+      view->out[view->len] = all->out[i];
+      view->len++;
+    }
+  }
+  if (view->len > 0)
+  {
+    ps = psim_create(ckt);
+    for (first = 0; first < view->len; first += WORD_BITS)
+    {
+      psim_load_patterns(ps, view, first);
+      psim_good_eval(ps);
+      psim_store_outputs(ps, view, first);
+    }
+    psim_free(ps);
+  }
+  /* first occurrences are now all filled in */
+  for (i = 0; i < all->len; i++)
+  {
+    if (rep[i] >= 0)
+      memcpy(all->out[i], all->out[rep[i]], ckt->npo * sizeof(int));
+  }
+  free(view);
+  free(rep);
+  *pat = *all;
+}
@@ -0,0 +1,280 @@
+#include "read_ckt.h"
+#include "psim.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*
+ * Tester datalog diagnosis.
+ *
+ * The datalog lists the (pattern, PO) pairs that failed on the tester.  A
+ * candidate stuck-at fault is scored by comparing its simulated failing
+ * set with the observed one: TFSF counts pairs failing on both, TFSP pairs
+ * the fault does not explain, TPSF pairs it predicts but the tester
+ * passed.  Candidates rank by TFSF, then by TPSF.
+ *
+ * Only faults in the fanin cone of some failing PO can explain a failure,
+ * so no other fault is simulated.  The failing patterns are packed into
+ * dense blocks and simulated against every candidate first; that fixes
+ * TFSF and TFSP.  Since TFSF ranks first, only the candidates that can
+ * still reach the top "ncand" then go through the passing patterns, which
+ * add to TPSF only.
+ */
+
+#define DIAG_LINE 1024
+
+extern void write_fault(); /* defined in main.c */
+
+typedef struct diag_struct diag_t;
+struct diag_struct
+{
+  int fault; /* index into the candidate array */
+  int tfsf;
+  int tfsp;
+  int tpsf;
+};
+
+/* qsort key: more failures explained, then fewer predicted in excess */
+static int diag_compare(const void *a, const void *b)
+{
+  const diag_t *da = (const diag_t *)a;
+  const diag_t *db = (const diag_t *)b;
+
+  if (da->tfsf != db->tfsf)
+    return (db->tfsf - da->tfsf);
+  if (da->tpsf != db->tpsf)
+    return (da->tpsf - db->tpsf);
+  return (da->fault - db->fault);
+}
+
+/* simulate faults cand[sel[0..nsel-1]] against the patterns idx[0..n-1];
+   tester failures, if any, are in fail[block * npo + po] */
+static void score(psim_t *ps, pattern_t *pat, pattern_t *view, int *idx,
+                  int n, fault_list_t **cand, diag_t *diag, int *sel,
+                  int nsel, word_t *fail)
+{
+  circuit_t *ckt = ps->ckt;
+  inject_t inj;
+  word_t d, t;
+  int first, b, s, e, g, j;
+
+  for (b = 0, first = 0; first < n; b++, first += WORD_BITS)
+  {
+    view->len = 0;
+    for (j = first; j < n && j < first + WORD_BITS; j++)
+      view->in[view->len++] = pat->in[idx[j]];
+    psim_load_patterns(ps, view, 0);
+    psim_good_eval(ps);
+    for (s = 0; s < nsel; s++)
+    {
+      psim_fault_inject(cand[diag[sel[s]].fault], &inj);
+      if (psim_propagate(ps, &inj, 1) == 0)
+        continue;
+      for (e = 0; e < ps->nevents; e++)
+      {
+        g = ps->events[e];
+        if ((j = ps->po_pos[g]) < 0)
+          continue;
+        d = ((ps->one[g] & ps->fzero[g]) | (ps->zero[g] & ps->fone[g])) &
+            ps->valid;
+        t = (fail != NULL) ? fail[(size_t)b * ckt->npo + j] : 0;
+        diag[sel[s]].tfsf += popcount(d & t);
+        diag[sel[s]].tpsf += popcount(d & ~t);
+      }
+    }
+  }
+}
+
+/*************************************************************************
+
+Function:  diagnose
+
+Purpose:  Reads the tester datalog from log_file and writes to out_file
+the "ncand" faults of flist that best explain it (see above), ties with
+the last one included.  Datalog lines hold a pattern index, counted from
+0 in the pattern file, and the name of a failing primary output; blank
+lines and lines starting with '#' are skipped.
+
+*************************************************************************/
+
+void diagnose(circuit_t *ckt, pattern_t *pat, fault_list_t *flist,
+              FILE *log_file, int ncand, FILE *out_file)
+{
+  psim_t *ps;
+  pattern_t *view;
+  fault_list_t **cand;
+  diag_t *diag;
+  word_t *fail, *w;
+  char line[DIAG_LINE], name[DIAG_LINE], *cone;
+  int *pos, *slot, *idx, *sel, *stack, *log_pat, *log_po, nlog, log_cap;
+  int nfail, nfailpat, npass, nfaults, nc, nsel, p, f, j, g, i, k, n;
+  int line_count;
+
+  pos = (int *)malloc(ckt->ngates * sizeof(int));
+  for (g = 0; g < ckt->ngates; g++)
+    pos[g] = -1;
+  for (j = 0; j < ckt->npo; j++)
+    pos[ckt->po[j]] = j;
+
+  /* the datalog */
+  log_cap = 64;
+  log_pat = (int *)malloc(log_cap * sizeof(int));
+  log_po = (int *)malloc(log_cap * sizeof(int));
+  nlog = 0;
+  line_count = 0;
+  while (fgets(line, sizeof(line), log_file) != NULL)
+  {
+    line_count++;
+    if (sscanf(line, "%1023s", name) != 1 || name[0] == '#')
+      continue;
+    if (sscanf(line, "%d %1023s", &p, name) != 2)
+    {
+      fprintf(stderr, "ERROR:  datalog line %d is malformed\n", line_count);
+      exit(-1);
+    }
+    g = Find_Gate(name, TRUE);
+    if (p < 0 || p >= pat->len || g < 0 || pos[g] < 0)
+    {
+      printf("Warning: skipping failure %d %s on line %d (unknown pattern or "
+             "output)\n",
+             p, name, line_count);
+      continue;
+    }
+    if (nlog == log_cap)
+    {
+      log_cap *= 2;
+      log_pat = (int *)realloc(log_pat, log_cap * sizeof(int));
+      log_po = (int *)realloc(log_po, log_cap * sizeof(int));
+    }
+    log_pat[nlog] = p;
+    log_po[nlog] = pos[g];
+    nlog++;
+  }
+
+  /* failing patterns packed first, in file order, then the passing ones */
+  slot = (int *)malloc((pat->len + 1) * sizeof(int));
+  for (p = 0; p < pat->len; p++)
+    slot[p] = -1;
+  for (i = 0; i < nlog; i++)
+    slot[log_pat[i]] = 0;
+  idx = (int *)malloc((pat->len + 1) * sizeof(int));
+  for (nfailpat = 0, p = 0; p < pat->len; p++)
+  {
+    if (slot[p] == 0)
+    {
+      slot[p] = nfailpat;
+      idx[nfailpat++] = p;
+    }
+  }
+  for (n = nfailpat, p = 0; p < pat->len; p++)
+  {
+    if (slot[p] < 0)
+      idx[n++] = p;
+  }
+  npass = pat->len - nfailpat;
+
+  /* tester failures as words of the packed failing patterns */
+  fail = (word_t *)calloc((size_t)((nfailpat + WORD_BITS - 1) / WORD_BITS) *
+                                  ckt->npo + 1,
+                          sizeof(word_t));
+  for (nfail = 0, i = 0; i < nlog; i++)
+  {
+    k = slot[log_pat[i]];
+    w = &fail[(size_t)(k / WORD_BITS) * ckt->npo + log_po[i]];
+    if (!(*w & LANE(k % WORD_BITS)))
+      nfail++;
+    *w |= LANE(k % WORD_BITS);
+  }
+
+  /* candidates: faults in the fanin cone of a failing PO */
+  cone = (char *)calloc(ckt->ngates, sizeof(char));
+  stack = (int *)malloc(ckt->ngates * sizeof(int));
+  for (i = 0; i < nlog; i++)
+  {
+    j = log_po[i];
+    if (cone[ckt->po[j]])
+      continue;
+    cone[ckt->po[j]] = TRUE;
+    stack[0] = ckt->po[j];
+    n = 1;
+    while (n > 0)
+    {
+      g = stack[--n];
+      if (ckt->gate[g].type == PI || ckt->gate[g].type == PO_GND ||
+          ckt->gate[g].type == PO_VCC)
+        continue;
+      for (p = 0; p < MAX_GATE_FANIN; p++)
+      {
+        k = ckt->gate[g].fanin[p];
+        if (k >= 0 && !cone[k])
+        {
+          cone[k] = TRUE;
+          stack[n++] = k;
+        }
+      }
+    }
+  }
+  cand = psim_fault_array(flist, &nfaults);
+  diag = (diag_t *)calloc(nfaults + 1, sizeof(diag_t));
+  sel = (int *)malloc((nfaults + 1) * sizeof(int));
+  for (nc = 0, f = 0; f < nfaults; f++)
+  {
+    if (!cone[cand[f]->gate_index])
+      continue;
+    diag[nc].fault = nc;
+    sel[nc] = nc;
+    cand[nc++] = cand[f];
+  }
+
+  /* failing patterns: TFSF, TFSP and part of TPSF for every candidate */
+  ps = psim_create(ckt);
+  view = (pattern_t *)malloc(sizeof(pattern_t));
+  score(ps, pat, view, idx, nfailpat, cand, diag, sel, nc, fail);
+  for (i = 0; i < nc; i++)
+    diag[i].tfsp = nfail - diag[i].tfsf;
+  qsort(diag, nc, sizeof(diag_t), diag_compare);
+
+  /* passing patterns: only candidates whose TFSF can still make the list */
+  for (nsel = 0; nsel < nc && diag[nsel].tfsf > 0; nsel++)
+  {
+    if (nsel >= ncand && diag[nsel].tfsf < diag[ncand - 1].tfsf)
+      break;
+    sel[nsel] = nsel;
+  }
+  score(ps, pat, view, idx + nfailpat, npass, cand, diag, sel, nsel, NULL);
+  psim_free(ps);
+  qsort(diag, nsel, sizeof(diag_t), diag_compare);
+
+  fprintf(out_file, "Failures = %d on %d of %d patterns\n", nfail, nfailpat,
+          pat->len);
+  fprintf(out_file, "Candidate Faults Simulated = %d (%d on passing patterns)\n",
+          nc, nsel);
+  fprintf(out_file, "\nDiagnosis:\n");
+  if (nsel == 0)
+    fprintf(out_file, "(Empty)\n");
+  for (i = 0; i < nsel; i++)
+  {
+    if (i >= ncand && (diag[i].tfsf != diag[ncand - 1].tfsf ||
+                       diag[i].tpsf != diag[ncand - 1].tpsf))
+      break;
+    fprintf(out_file, "%d. TFSF = %d, TFSP = %d, TPSF = %d  ", i + 1,
+            diag[i].tfsf, diag[i].tfsp, diag[i].tpsf);
+    write_fault(ckt, cand[diag[i].fault], out_file);
+  }
+  fprintf(out_file, "\n");
+
+  free(view);
+  free(pos);
+  free(log_pat);
+  free(log_po);
+  free(slot);
+  free(idx);
+  free(fail);
+  free(cone);
+  free(stack);
+  free(cand);
+  free(diag);
+  free(sel);
+}
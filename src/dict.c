@@ -0,0 +1,213 @@
+#include "project.h"
+#include "psim.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*
+ * Fault dictionary.
+ *
+ * Every fault is simulated against every pattern block, without dropping.
+ * The failing (pattern, PO) set of a fault is summarized by a 64-bit
+ * signature: the sum of a hash of each (block, PO, failing lanes) word.
+ * Addition commutes, so the signature does not depend on the order in
+ * which the kernel reports the outputs, and two faults with the same
+ * failing set always get the same signature.  With "full" set, the failing
+ * words themselves are kept as a sparse bitmap.
+ *
+ * The dictionary file is binary, in native byte order:
+ *
+ *   char magic[8]                  "3FSDICT" and a NUL
+ *   int npatterns, npo, nfaults, full
+ *   per fault, in list order:
+ *     int gate_index, input_index, type
+ *     int nfail                    failing (pattern, PO) pairs
+ *     int first_fail               first failing pattern, -1 if none
+ *     word_t signature             0 if none
+ *     if full:  int nwords, then nwords times
+ *               int block, int po, word_t lanes
+ *
+ * Pattern p of block b is bit p % 64 of the lanes of block p / 64.
+ */
+
+#define DICT_MAGIC "3FSDICT"
+
+typedef struct fail_word_struct fail_word_t;
+struct fail_word_struct
+{
+  int block;
+  int po;
+  word_t lanes;
+};
+
+typedef struct dict_entry_struct dict_entry_t;
+struct dict_entry_struct
+{
+  int nfail;
+  int first_fail;
+  word_t signature;
+  int nwords;
+  int cap;
+  fail_word_t *words; /* only when full */
+};
+
+/* splitmix64 finalizer */
+static word_t mix64(word_t x)
+{
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return (x);
+}
+
+static int signature_compare(const void *a, const void *b)
+{
+  word_t sa = *(const word_t *)a, sb = *(const word_t *)b;
+
+  return ((sa < sb) ? -1 : (sa > sb) ? 1 : 0);
+}
+
+static void write_int(int v, FILE *dict_file)
+{
+  fwrite(&v, sizeof(int), 1, dict_file);
+}
+
+/*************************************************************************
+
+Function:  dictionary_simulate
+
+Purpose:  Same contract as parallel_fault_simulate(), but no fault is
+dropped: the failing set of every fault is recorded (see above) and the
+dictionary is written to dict_file.  The number of distinct signatures
+among the detected faults, i.e. the diagnostic resolution, is printed.
+
+Return:  List of faults that remain undetected, in their original order.
+
+*************************************************************************/
+
+fault_list_t *dictionary_simulate(circuit_t *ckt, pattern_t *pat,
+                                  fault_list_t *undetected_flist, int full,
+                                  FILE *dict_file)
+{
+  psim_t *ps;
+  fault_list_t **faults;
+  dict_entry_t *dict, *de;
+  char *detected;
+  inject_t inj;
+  word_t d, *sigs;
+  char magic[8];
+  int nfaults, f, e, g, j, b, first, ndetected, ndistinct;
+
+  faults = psim_fault_array(undetected_flist, &nfaults);
+  dict = (dict_entry_t *)calloc(nfaults + 1, sizeof(dict_entry_t));
+  for (f = 0; f < nfaults; f++)
+    dict[f].first_fail = -1;
+
+  ps = psim_create(ckt);
+  for (b = 0, first = 0; first < pat->len; b++, first += WORD_BITS)
+  {
+    psim_load_patterns(ps, pat, first);
+    psim_good_eval(ps);
+    psim_store_outputs(ps, pat, first);
+    for (f = 0; f < nfaults; f++)
+    {
+      psim_fault_inject(faults[f], &inj);
+      if (psim_propagate(ps, &inj, 1) == 0)
+        continue;
+      de = &dict[f];
+      for (e = 0; e < ps->nevents; e++)
+      {
+        g = ps->events[e];
+        if ((j = ps->po_pos[g]) < 0)
+          continue;
+        d = ((ps->one[g] & ps->fzero[g]) | (ps->zero[g] & ps->fone[g])) &
+            ps->valid;
+        if (d == 0)
+          continue;
+        de->signature += mix64(mix64(((word_t)b << 32) | (word_t)j) ^ d);
+        de->nfail += popcount(d);
+        if (de->first_fail < 0 || de->first_fail > first + lowest_lane(d))
+          de->first_fail = first + lowest_lane(d);
+        if (!full)
+          continue;
+        if (de->nwords == de->cap)
+        {
+          de->cap = (de->cap == 0) ? 4 : 2 * de->cap;
+          de->words = (fail_word_t *)realloc(de->words,
+                                             de->cap * sizeof(fail_word_t));
+        }
+        de->words[de->nwords].block = b;
+        de->words[de->nwords].po = j;
+        de->words[de->nwords].lanes = d;
+        de->nwords++;
+      }
+    }
+  }
+  psim_free(ps);
+
+  /* write the dictionary */
+  memset(magic, 0, sizeof(magic));
+  strcpy(magic, DICT_MAGIC);
+  fwrite(magic, sizeof(magic), 1, dict_file);
+  write_int(pat->len, dict_file);
+  write_int(ckt->npo, dict_file);
+  write_int(nfaults, dict_file);
+  write_int(full, dict_file);
+  for (f = 0; f < nfaults; f++)
+  {
+    de = &dict[f];
+    write_int(faults[f]->gate_index, dict_file);
+    write_int(faults[f]->input_index, dict_file);
+    write_int(faults[f]->type, dict_file);
+    write_int(de->nfail, dict_file);
+    write_int(de->first_fail, dict_file);
+    fwrite(&de->signature, sizeof(word_t), 1, dict_file);
+    if (!full)
+      continue;
+    write_int(de->nwords, dict_file);
+    for (j = 0; j < de->nwords; j++)
+    {
+      write_int(de->words[j].block, dict_file);
+      write_int(de->words[j].po, dict_file);
+      fwrite(&de->words[j].lanes, sizeof(word_t), 1, dict_file);
+    }
+  }
+
+  /* diagnostic resolution */
+  sigs = (word_t *)malloc((nfaults + 1) * sizeof(word_t));
+  for (ndetected = 0, f = 0; f < nfaults; f++)
+  {
+    if (dict[f].nfail > 0)
+      sigs[ndetected++] = dict[f].signature;
+  }
+  qsort(sigs, ndetected, sizeof(word_t), signature_compare);
+  for (ndistinct = 0, f = 0; f < ndetected; f++)
+  {
+    if (f == 0 || sigs[f] != sigs[f - 1])
+      ndistinct++;
+  }
+  printf("Dictionary: %d detected faults, %d distinct signatures\n",
+         ndetected, ndistinct);
+  free(sigs);
+
+  detected = (char *)calloc(nfaults + 1, sizeof(char));
+  for (f = 0; f < nfaults; f++)
+  {
+    if (dict[f].nfail > 0)
+    {
+      detected[f] = TRUE;
+      faults[f]->detect_index = dict[f].first_fail;
+    }
+  }
+  undetected_flist = psim_unlink_detected(faults, detected, nfaults);
+  free(detected);
+  for (f = 0; f < nfaults; f++)
+    free(dict[f].words);
+  free(dict);
+  free(faults);
+  return (undetected_flist);
+}
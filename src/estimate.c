@@ -0,0 +1,196 @@
+#include "project.h"
+#include "psim.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+
+/*
+ * Analytical fault coverage estimate (STAFAN).
+ *
+ * Only the fault-free circuit is simulated.  Over the simulated patterns
+ * each gate input keeps two counts: patterns where it is 1 (0) and
+ * sensitized to the gate output.  Their ratios replace the COP products,
+ * so the reconvergence seen by the good machine is accounted for.  The
+ * observabilities are then propagated backwards as in COP and the
+ * detection probability p of each fault gives its expected detection by N
+ * random patterns, 1 - (1 - p)^N.
+ */
+
+extern void write_fault(); /* defined in main.c */
+extern void cop_observability(); /* defined in cop.c */
+
+#define ESCAPE_LIMIT 0.5 /* list faults more likely missed than caught */
+
+/* load sample rows first, first + 1, ... of nrows spread evenly over the
+   pattern file into the lanes */
+static int load_sampled(psim_t *ps, pattern_t *pat, int first, int nrows)
+{
+  circuit_t *ckt = ps->ckt;
+  int i, p;
+  int *row;
+
+  for (i = 0; i < ckt->npi; i++)
+  {
+    if (ckt->pi[i] < 0)
+      continue;
+    ps->zero[ckt->pi[i]] = 0;
+    ps->one[ckt->pi[i]] = 0;
+  }
+  for (p = 0; p < WORD_BITS && first + p < nrows; p++)
+  {
+    row = pat->in[(long long)(first + p) * pat->len / nrows];
+    for (i = 0; i < ckt->npi; i++)
+    {
+      if (ckt->pi[i] < 0)
+        continue;
+      if (row[i] == LOGIC_0)
+        ps->zero[ckt->pi[i]] |= LANE(p);
+      else if (row[i] == LOGIC_1)
+        ps->one[ckt->pi[i]] |= LANE(p);
+    }
+  }
+  ps->valid = (p == WORD_BITS) ? ALL_ONES : LANE(p) - 1;
+  return (p);
+}
+
+/*************************************************************************
+
+Function:  estimate_coverage
+
+Purpose:  Simulates the good machine over the patterns ("sample" rows
+spread evenly over the file when it is smaller than pat->len), gathers
+the STAFAN counts and writes the estimated coverage of 1, 2, 4, ... up
+to "npatterns" random patterns drawn like them, followed by the faults
+expected to escape npatterns patterns.
+
+*************************************************************************/
+
+void estimate_coverage(circuit_t *ckt, pattern_t *pat, fault_list_t *flist,
+                       int num_faults, int npatterns, int sample,
+                       FILE *out_file)
+{
+  psim_t *ps;
+  fault_list_t *fptr;
+  gate_t *g;
+  double *c1, *sens, *obs, *prob, sum, n;
+  unsigned long long *ones, *sens1, *sens0, *senscnt, nsim;
+  word_t s, z, o;
+  int i, k, f, nrows, first, count;
+
+  nrows = (sample > 0 && sample < pat->len) ? sample : pat->len;
+  ones = (unsigned long long *)calloc(ckt->ngates, sizeof(unsigned long long));
+  sens1 = (unsigned long long *)calloc(ckt->ngates * MAX_GATE_FANIN,
+                                       sizeof(unsigned long long));
+  sens0 = (unsigned long long *)calloc(ckt->ngates * MAX_GATE_FANIN,
+                                       sizeof(unsigned long long));
+  senscnt = (unsigned long long *)calloc(ckt->ngates * MAX_GATE_FANIN,
+                                         sizeof(unsigned long long));
+
+  ps = psim_create(ckt);
+  nsim = 0;
+  for (first = 0; first < nrows; first += WORD_BITS)
+  {
+    nsim += load_sampled(ps, pat, first, nrows);
+    psim_good_eval(ps);
+    for (i = 0; i < ckt->ngates; i++)
+    {
+      g = &ckt->gate[i];
+      ones[i] += popcount(ps->one[i] & ps->valid);
+      for (k = 0; k < MAX_GATE_FANIN; k++)
+      {
+        switch (g->type)
+        {
+        case AND:
+        case NAND:
+          s = ps->one[g->fanin[1 - k]];
+          break;
+        case OR:
+        case NOR:
+          s = ps->zero[g->fanin[1 - k]];
+          break;
+        case INV:
+        case BUF:
+        case PO:
+          s = (k == 0) ? ALL_ONES : 0;
+          break;
+        default:
+          s = 0;
+        }
+        s &= ps->valid;
+        if (s == 0)
+          continue;
+        z = ps->zero[g->fanin[k]];
+        o = ps->one[g->fanin[k]];
+        senscnt[i * MAX_GATE_FANIN + k] += popcount(s);
+        sens1[i * MAX_GATE_FANIN + k] += popcount(s & o);
+        sens0[i * MAX_GATE_FANIN + k] += popcount(s & z);
+      }
+    }
+  }
+  psim_free(ps);
+
+  c1 = (double *)malloc(ckt->ngates * sizeof(double));
+  sens = (double *)malloc(ckt->ngates * MAX_GATE_FANIN * sizeof(double));
+  obs = (double *)malloc(ckt->ngates * sizeof(double));
+  prob = (double *)malloc((num_faults + 1) * sizeof(double));
+  n = (nsim > 0) ? (double)nsim : 1.0;
+  for (i = 0; i < ckt->ngates; i++)
+  {
+    c1[i] = ones[i] / n;
+    for (k = 0; k < MAX_GATE_FANIN; k++)
+      sens[i * MAX_GATE_FANIN + k] = senscnt[i * MAX_GATE_FANIN + k] / n;
+  }
+  cop_observability(ckt, sens, obs);
+
+  /* detection probability of each fault */
+  for (f = 0, fptr = flist; fptr != NULL; fptr = fptr->next, f++)
+  {
+    i = fptr->gate_index;
+    k = fptr->input_index;
+    if (k < 0)
+      prob[f] = ((fptr->type == S_A_0) ? c1[i] : 1.0 - c1[i]) * obs[i];
+    else if (fptr->type == S_A_0)
+      prob[f] = sens1[i * MAX_GATE_FANIN + k] / n * obs[i];
+    else
+      prob[f] = sens0[i * MAX_GATE_FANIN + k] / n * obs[i];
+  }
+
+  fprintf(out_file, "Good Machine Patterns Simulated = %llu\n", nsim);
+  fprintf(out_file, "\nEstimated Coverage Curve:\n");
+  for (count = 1;; count = (count * 2 < npatterns) ? count * 2 : npatterns)
+  {
+    for (sum = 0.0, f = 0; f < num_faults; f++)
+      sum += (prob[f] >= 1.0) ? 1.0 : 1.0 - exp(count * log1p(-prob[f]));
+    fprintf(out_file, "%10d patterns  %5.1f%%\n", count,
+            100.0 * sum / num_faults);
+    if (count == npatterns)
+      break;
+  }
+
+  fprintf(out_file, "\nList of Likely Undetected Faults:\n");
+  count = 0;
+  for (f = 0, fptr = flist; fptr != NULL; fptr = fptr->next, f++)
+  {
+    if (prob[f] < 1.0 && exp(npatterns * log1p(-prob[f])) >= ESCAPE_LIMIT)
+    {
+      count++;
+      write_fault(ckt, fptr, out_file);
+    }
+  }
+  if (count == 0)
+    fprintf(out_file, "(Empty)\n");
+  fprintf(out_file, "\nTotal Number of Faults = %d\n", num_faults);
+  fprintf(out_file, "Number of Likely Undetected Faults = %d\n", count);
+
+  free(ones);
+  free(sens1);
+  free(sens0);
+  free(senscnt);
+  free(c1);
+  free(sens);
+  free(obs);
+  free(prob);
+}
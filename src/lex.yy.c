@@ -999,7 +999,7 @@ YY_RULE_SETUP
 case 12:
 YY_RULE_SETUP
 #line 72 "blif.l"
-{ return (BLIF_SEQ); }
+{ return (BLIF_LATCH); }
 	YY_BREAK
 case 13:
 YY_RULE_SETUP
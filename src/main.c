@@ -1,4 +1,5 @@
 #include "project.h"
+#include "psim.h"
 #include <stddef.h>
 #include <string.h>
 #include <stdio.h>
@@ -7,27 +8,176 @@
 #include <sys/times.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <math.h>
 
 /* Global Variables */
 
 circuit_t ckt;
 pattern_t pat;
 int debug;
+int parallel;     /* use the pattern-parallel engine */
+int threads;      /* or spread its faults over this many threads */
+int thread_patterns; /* spread the pattern blocks instead */
+char *bridge_filename;  /* simulate the bridges listed in this file */
+int bridge_sample;      /* or this many sampled pairs of adjacent nets */
+int multi_k;            /* simulate tuples of this many faults */
+int multi_sample = 10000;  /* number of tuples */
+unsigned long seed = 1; /* seed of all random choices */
+int frames;             /* apply patterns as sequences of this many cycles */
+bist_t bist = { 0, 0x100400007ULL, 1, 3, 0x100400007ULL, 0, 0 }; /* LFSR/MISR setup */
+int weighted;           /* generate this many weighted random patterns */
+int estimate;           /* estimate the coverage of this many patterns */
+int estimate_sample;    /* good-simulate only this many of them */
+double fault_sample;    /* simulate this fraction of the faults, 0 for all */
+int stratum_size[UNKNOWN+1];   /* faults per gate type in the universe */
+int stratum_sample[UNKNOWN+1]; /* and in the sample */
+int order;              /* ORDER_SCOAP or ORDER_LEVEL, 0 for list order */
+int atpg;               /* top off with PODEM tests */
+int backtracks = 100;   /* PODEM backtrack limit per fault */
+int redundancy;         /* prove faults redundant before simulation */
+fault_list_t *redundant_flist; /* the faults proven redundant */
+int num_redundant;
+char *compact_filename;  /* write the compacted patterns to this file */
+int greedy;             /* finish compaction with a greedy set cover */
+int dedupe;             /* simulate each distinct pattern once */
+int x_subsume;          /* and skip patterns another one refines */
+pattern_t all_pat;      /* the patterns as read, while deduplicated */
+int test_points;        /* pick this many test points for the escapes */
+char *mask_filename;    /* primary outputs the tester does not observe */
+char *fault_filename;   /* simulate the faults listed here, not all of them */
+char *dict_filename;    /* write a fault dictionary to this file */
+int dict_full;          /* with the failing bits, not just signatures */
+char *diag_filename;    /* diagnose the tester failures in this file */
+int diag_candidates = 10; /* report this many candidate faults */
+int verify;             /* check the expected responses in pattern_file */
+int good_only;          /* only write the fault-free responses */
+int curve;              /* write the coverage after each detecting pattern */
+fault_list_t **curve_faults; /* the simulated faults, for the curve */
+int num_curve_faults;
+char *power_filename;   /* write the switching activity to this file */
+int collapse_mode = COLLAPSE_EQUIV; /* simulate one fault per class */
+collapse_t collapse;    /* the classes, while collapsed */
 
 extern char *pi_order_name_array[];
 extern int pi_order_num;
 
+void init_io();
 fault_list_t *init_fault_list();
 fault_list_t *add_fault();
+fault_list_t *sample_fault_list();
+void write_sample_estimate();
+void write_coverage_curve();
 void read_patterns();
+int read_po_mask();
+fault_list_t *read_fault_list();
 void write_output();
+void write_patterns();
+void write_pattern_file();
+void write_fault();
 extern void read_circuit(); /* defined in read_ckt.c */
+extern int Find_Gate(); /* defined in build_ckt.c */
 extern fault_list_t *three_val_fault_simulate(); /* defined in project.c */
+extern bridge_list_t *read_bridge_list(); /* defined in bridge.c */
+extern bridge_list_t *sample_bridge_list();
+extern bridge_list_t *bridge_fault_simulate();
+extern void write_bridge_output();
+extern multi_fault_t *sample_multi_faults(); /* defined in multi.c */
+extern multi_fault_t *multi_fault_simulate();
+extern void write_multi_output();
+extern fault_list_t *sequential_fault_simulate(); /* defined in seq.c */
+extern void bist_check(); /* defined in bist.c */
+extern fault_list_t *bist_fault_simulate();
+extern void write_bist_signature();
+extern fault_list_t *weighted_random_simulate(); /* defined in cop.c */
+extern void estimate_coverage(); /* defined in estimate.c */
+extern fault_list_t *ordered_fault_simulate(); /* defined in scoap.c */
+extern fault_list_t *atpg_top_off(); /* defined in atpg.c */
+extern fault_list_t *identify_redundant(); /* defined in redund.c */
+extern fault_list_t *compact_patterns(); /* defined in compact.c */
+extern int *dedupe_patterns(); /* defined in dedupe.c */
+extern void expand_patterns();
+extern void dedupe_detect_index();
+extern void test_point_analysis(); /* defined in tpi.c */
+extern fault_list_t *dictionary_simulate(); /* defined in dict.c */
+extern void diagnose(); /* defined in diag.c */
+extern void verify_responses(); /* defined in verify.c */
+extern long long good_simulate();
+extern power_t *power_create(); /* defined in power.c */
+extern void power_write();
+extern void power_free();
+extern fault_list_t *collapse_faults(); /* defined in collapse.c */
+extern fault_list_t *expand_faults();
+extern fault_list_t *threaded_fault_simulate(); /* defined in threads.c */
+extern fault_list_t *pattern_threaded_fault_simulate();
 
 void print_usage()
 {
-  printf("usage:  3fsim [-h] circuit_file pattern_file output_file\n");
+  printf("usage:  3fsim [-h] [options] circuit_file pattern_file output_file\n");
+  printf("        3fsim --bist n | --weighted n [options] circuit_file output_file\n");
   printf("\t-h shows usage\n");
+  printf("\t--parallel simulates 64 patterns at a time\n");
+  printf("\t--threads n spreads the faults of every 64-pattern block over n\n");
+  printf("\t\tthreads, balanced by work stealing (pattern-parallel)\n");
+  printf("\t--thread-patterns gives every thread whole pattern blocks instead,\n");
+  printf("\t\twith the detected faults shared in a bitmap (with --threads)\n");
+  printf("\t--bridge file simulates the bridging faults listed in file\n");
+  printf("\t--bridge-sample n simulates bridges between n sampled pairs of adjacent nets\n");
+  printf("\t--multi k simulates sampled tuples of k stuck-at faults\n");
+  printf("\t--multi-sample n sets the number of tuples (default 10000)\n");
+  printf("\t--seed s seeds all random choices\n");
+  printf("\t--frames k applies the patterns as sequences of k clock cycles,\n");
+  printf("\t\tcarrying the latch state from one pattern to the next\n");
+  printf("\t--bist n applies n LFSR patterns and reports the MISR signature\n");
+  printf("\t--lfsr-poly p, --lfsr-seed s set the LFSR (hex, default 0x100400007, 1)\n");
+  printf("\t--phase-taps t XORs t LFSR cells into each input (default 3)\n");
+  printf("\t--misr-poly p sets the MISR polynomial (hex, default 0x100400007)\n");
+  printf("\t--weighted n generates up to n random patterns, weighted by COP\n");
+  printf("\t\ttowards the faults still undetected\n");
+  printf("\t--estimate n estimates the coverage of up to n patterns like those in\n");
+  printf("\t\tpattern_file from good machine statistics (STAFAN), no fault simulation\n");
+  printf("\t--estimate-sample m good-simulates only m patterns, spread evenly\n");
+  printf("\t\tover pattern_file\n");
+  printf("\t--fault-sample f simulates a random fraction f (or f%%) of the faults,\n");
+  printf("\t\tstratified by gate type, and reports a confidence interval\n");
+  printf("\t--order scoap|level simulates the easy half of the faults, by SCOAP\n");
+  printf("\t\tcost or level, in file order and the hard half on the high-yield\n");
+  printf("\t\tpattern blocks first (pattern-parallel)\n");
+  printf("\t--atpg generates PODEM tests for the faults the patterns miss and\n");
+  printf("\t\tappends them to the pattern list\n");
+  printf("\t--backtracks n sets the PODEM backtrack limit per fault (default 100)\n");
+  printf("\t--redundancy proves faults redundant from the netlist and leaves them\n");
+  printf("\t\tout of the simulation\n");
+  printf("\t--compact file drops the patterns that detect no fault of their own\n");
+  printf("\t\t(reverse order first) and writes the rest to file\n");
+  printf("\t--greedy finishes --compact with a greedy set cover\n");
+  printf("\t--curve writes the fault coverage after each pattern that detects a\n");
+  printf("\t\tfault first\n");
+  printf("\t--dedupe simulates repeated patterns once\n");
+  printf("\t--x-subsume also skips patterns with X inputs that another pattern\n");
+  printf("\t\trefines (implies --dedupe)\n");
+  printf("\t--fault-list file simulates only the faults listed in file, one per\n");
+  printf("\t\tline as \"name pin S_A_v\" (pin output or inputK) or as written\n");
+  printf("\t\tin the output file\n");
+  printf("\t--po-mask file ignores the primary outputs listed in file, one per\n");
+  printf("\t\tline (pattern-parallel engines)\n");
+  printf("\t--dictionary file simulates without fault dropping and writes the\n");
+  printf("\t\tfailing-set signature of every fault to file (binary)\n");
+  printf("\t--dict-full also writes the failing pattern/PO bits\n");
+  printf("\t--diagnose file ranks the faults by how well they explain the tester\n");
+  printf("\t\tfailures in file, one \"pattern_index output_name\" per line\n");
+  printf("\t--candidates n reports the n best candidates (default 10)\n");
+  printf("\t--good-only streams pattern_file through the good machine and writes\n");
+  printf("\t\tonly the responses (no fault list, no fault simulation)\n");
+  printf("\t--power file writes the weighted switching activity of every pattern\n");
+  printf("\t\tand logic level to file (--parallel)\n");
+  printf("\t--verify good-simulates pattern_file, \"inputs -> outputs\" lines as in\n");
+  printf("\t\toutput_file, and reports the outputs that differ (no fault simulation)\n");
+  printf("\t--collapse none|equiv|dom simulates one fault of every class of\n");
+  printf("\t\tstructurally equivalent faults (default equiv, pattern-parallel\n");
+  printf("\t\tengines); dom also leaves out the faults dominance implies,\n");
+  printf("\t\tfor a lower bound on the coverage (combinational patterns)\n");
+  printf("\t--test-points k reports the faults each observation or control point\n");
+  printf("\t\twould add and a greedy choice of k points\n");
   printf("\tcircuit_file is the circuit description to read in\n");
   printf("\tpattern_file is the pattern file to read\n\n");
   printf("\toutput_file is the output file to write\n\n");
@@ -37,12 +187,19 @@ main (argc,argv)
      int argc;
      char *argv[];
 {
-  FILE *pat_file, *ckt_file, *out_file;
+  FILE *pat_file, *ckt_file, *out_file, *bridge_file, *mask_file, *dict_file;
+  FILE *diag_file, *power_file, *fault_file;
   char ckt_filename[256], pat_filename[256], out_filename[256];
   struct rusage start_time, finish_time;  
+  struct timeval start_wall, finish_wall;
   unsigned long time;
   fault_list_t *flist,*undetected_flist, *ptr, **fault_array;
-  int num_faults,i;
+  bridge_list_t *blist, *undetected_blist, *bptr;
+  multi_fault_t *mlist, *undetected_mlist, *mptr;
+  int num_faults,num_bridges,num_tuples,own_patterns,num_patterns,i;
+  int *pattern_rep, num_masked, num_simulated, collapsed;
+  atpg_stats_t atpg_stats;
+  power_t *power;
 
   for (i = 1; i < argc; i++) {
     if ( argv[i][0] == '-' ) {
@@ -54,13 +211,289 @@ main (argc,argv)
 	printf("debug_mode = ON\n");
 	debug = TRUE;
 	break;
+      case '-':
+	if ( strcmp(argv[i],"--parallel") == 0 ) {
+	  parallel = TRUE;
+	}
+	else if ( strcmp(argv[i],"--thread-patterns") == 0 ) {
+	  thread_patterns = TRUE;
+	}
+	else if ( strcmp(argv[i],"--threads") == 0 && i+1 < argc ) {
+	  threads = atoi(argv[++i]);
+	  if ( threads <= 0 ) {
+	    fprintf(stderr,"ERROR:  --threads needs a positive count\n");
+	    exit(-1);
+	  }
+	}
+	else if ( strcmp(argv[i],"--bridge") == 0 && i+1 < argc ) {
+	  bridge_filename = argv[++i];
+	}
+	else if ( strcmp(argv[i],"--bridge-sample") == 0 && i+1 < argc ) {
+	  bridge_sample = atoi(argv[++i]);
+	}
+	else if ( strcmp(argv[i],"--multi") == 0 && i+1 < argc ) {
+	  multi_k = atoi(argv[++i]);
+	}
+	else if ( strcmp(argv[i],"--multi-sample") == 0 && i+1 < argc ) {
+	  multi_sample = atoi(argv[++i]);
+	}
+	else if ( strcmp(argv[i],"--seed") == 0 && i+1 < argc ) {
+	  seed = strtoul(argv[++i],NULL,0);
+	}
+	else if ( strcmp(argv[i],"--bist") == 0 && i+1 < argc ) {
+	  /* accepts 1e8 and the like */
+	  bist.npatterns = (unsigned long long)strtod(argv[++i],NULL);
+	  if ( bist.npatterns == 0 ) {
+	    fprintf(stderr,"ERROR:  --bist needs a positive pattern count\n");
+	    exit(-1);
+	  }
+	}
+	else if ( strcmp(argv[i],"--lfsr-poly") == 0 && i+1 < argc ) {
+	  bist.lfsr_poly = strtoull(argv[++i],NULL,16);
+	}
+	else if ( strcmp(argv[i],"--lfsr-seed") == 0 && i+1 < argc ) {
+	  bist.lfsr_seed = strtoull(argv[++i],NULL,16);
+	}
+	else if ( strcmp(argv[i],"--phase-taps") == 0 && i+1 < argc ) {
+	  bist.phase_taps = atoi(argv[++i]);
+	}
+	else if ( strcmp(argv[i],"--misr-poly") == 0 && i+1 < argc ) {
+	  bist.misr_poly = strtoull(argv[++i],NULL,16);
+	}
+	else if ( strcmp(argv[i],"--weighted") == 0 && i+1 < argc ) {
+	  weighted = atoi(argv[++i]);
+	  if ( weighted <= 0 ) {
+	    fprintf(stderr,"ERROR:  --weighted needs a positive pattern count\n");
+	    exit(-1);
+	  }
+	}
+	else if ( strcmp(argv[i],"--estimate") == 0 && i+1 < argc ) {
+	  estimate = atoi(argv[++i]);
+	  if ( estimate <= 0 ) {
+	    fprintf(stderr,"ERROR:  --estimate needs a positive pattern count\n");
+	    exit(-1);
+	  }
+	}
+	else if ( strcmp(argv[i],"--estimate-sample") == 0 && i+1 < argc ) {
+	  estimate_sample = atoi(argv[++i]);
+	}
+	else if ( strcmp(argv[i],"--fault-sample") == 0 && i+1 < argc ) {
+	  char *end;
+
+	  fault_sample = strtod(argv[++i],&end);
+	  if ( *end == '%' )
+	    fault_sample /= 100.0;
+	  if ( fault_sample <= 0.0 || fault_sample > 1.0 ) {
+	    fprintf(stderr,"ERROR:  --fault-sample needs a fraction in (0,1]\n");
+	    exit(-1);
+	  }
+	}
+	else if ( strcmp(argv[i],"--order") == 0 && i+1 < argc ) {
+	  i++;
+	  if ( strcmp(argv[i],"scoap") == 0 )
+	    order = ORDER_SCOAP;
+	  else if ( strcmp(argv[i],"level") == 0 )
+	    order = ORDER_LEVEL;
+	  else {
+	    fprintf(stderr,"ERROR:  --order takes scoap or level\n");
+	    exit(-1);
+	  }
+	}
+	else if ( strcmp(argv[i],"--atpg") == 0 ) {
+	  atpg = TRUE;
+	}
+	else if ( strcmp(argv[i],"--backtracks") == 0 && i+1 < argc ) {
+	  backtracks = atoi(argv[++i]);
+	}
+	else if ( strcmp(argv[i],"--redundancy") == 0 ) {
+	  redundancy = TRUE;
+	}
+	else if ( strcmp(argv[i],"--compact") == 0 && i+1 < argc ) {
+	  compact_filename = argv[++i];
+	}
+	else if ( strcmp(argv[i],"--greedy") == 0 ) {
+	  greedy = TRUE;
+	}
+	else if ( strcmp(argv[i],"--dictionary") == 0 && i+1 < argc ) {
+	  dict_filename = argv[++i];
+	}
+	else if ( strcmp(argv[i],"--dict-full") == 0 ) {
+	  dict_full = TRUE;
+	}
+	else if ( strcmp(argv[i],"--diagnose") == 0 && i+1 < argc ) {
+	  diag_filename = argv[++i];
+	}
+	else if ( strcmp(argv[i],"--candidates") == 0 && i+1 < argc ) {
+	  diag_candidates = atoi(argv[++i]);
+	  if ( diag_candidates <= 0 ) {
+	    fprintf(stderr,"ERROR:  --candidates needs a positive count\n");
+	    exit(-1);
+	  }
+	}
+	else if ( strcmp(argv[i],"--power") == 0 && i+1 < argc ) {
+	  power_filename = argv[++i];
+	}
+	else if ( strcmp(argv[i],"--good-only") == 0 ) {
+	  good_only = TRUE;
+	}
+	else if ( strcmp(argv[i],"--verify") == 0 ) {
+	  verify = TRUE;
+	}
+	else if ( strcmp(argv[i],"--fault-list") == 0 && i+1 < argc ) {
+	  fault_filename = argv[++i];
+	}
+	else if ( strcmp(argv[i],"--po-mask") == 0 && i+1 < argc ) {
+	  mask_filename = argv[++i];
+	}
+	else if ( strcmp(argv[i],"--test-points") == 0 && i+1 < argc ) {
+	  test_points = atoi(argv[++i]);
+	  if ( test_points <= 0 ) {
+	    fprintf(stderr,"ERROR:  --test-points needs a positive count\n");
+	    exit(-1);
+	  }
+	}
+	else if ( strcmp(argv[i],"--collapse") == 0 && i+1 < argc ) {
+	  i++;
+	  if ( strcmp(argv[i],"none") == 0 )
+	    collapse_mode = COLLAPSE_NONE;
+	  else if ( strcmp(argv[i],"equiv") == 0 )
+	    collapse_mode = COLLAPSE_EQUIV;
+	  else if ( strcmp(argv[i],"dom") == 0 )
+	    collapse_mode = COLLAPSE_DOM;
+	  else {
+	    fprintf(stderr,"ERROR:  --collapse takes none, equiv or dom\n");
+	    exit(-1);
+	  }
+	}
+	else if ( strcmp(argv[i],"--curve") == 0 ) {
+	  curve = TRUE;
+	}
+	else if ( strcmp(argv[i],"--dedupe") == 0 ) {
+	  dedupe = TRUE;
+	}
+	else if ( strcmp(argv[i],"--x-subsume") == 0 ) {
+	  dedupe = x_subsume = TRUE;
+	}
+	else if ( strcmp(argv[i],"--frames") == 0 && i+1 < argc ) {
+	  frames = atoi(argv[++i]);
+	  if ( frames < 1 ) {
+	    fprintf(stderr,"ERROR:  --frames needs a positive count\n");
+	    exit(-1);
+	  }
+	}
+	else {
+	  fprintf(stderr,"ERROR:  unknown option %s\n",argv[i]);
+	  print_usage();
+	  exit(-1);
+	}
+	break;
       }
     }
     else {
       break;
     }
   }
-  if ( i >= (argc-2) ) {
+  /* BIST and weighted random generation make their own patterns and take
+     no pattern file */
+  own_patterns = (bist.npatterns > 0) || (weighted > 0);
+  if ( atpg && (bist.npatterns > 0 || frames > 0 || estimate > 0 || multi_k > 0 ||
+		bridge_filename != NULL || bridge_sample > 0) ) {
+    fprintf(stderr,"ERROR:  --atpg tops off single stuck-at simulation of combinational patterns only\n");
+    exit(-1);
+  }
+  if ( compact_filename != NULL && (bist.npatterns > 0 || frames > 0 || estimate > 0 ||
+				    multi_k > 0 || bridge_filename != NULL || bridge_sample > 0) ) {
+    fprintf(stderr,"ERROR:  --compact works on combinational stuck-at patterns only\n");
+    exit(-1);
+  }
+  if ( redundancy && (estimate > 0 || multi_k > 0 || bridge_filename != NULL ||
+		      bridge_sample > 0) ) {
+    fprintf(stderr,"ERROR:  --redundancy applies to single stuck-at simulation only\n");
+    exit(-1);
+  }
+  if ( test_points > 0 && (bist.npatterns > 0 || frames > 0 || estimate > 0 ||
+			   multi_k > 0 || bridge_filename != NULL || bridge_sample > 0) ) {
+    fprintf(stderr,"ERROR:  --test-points works on combinational stuck-at patterns only\n");
+    exit(-1);
+  }
+  if ( dict_filename != NULL && (bist.npatterns > 0 || weighted > 0 || frames > 0 ||
+				 estimate > 0 || multi_k > 0 || bridge_filename != NULL ||
+				 bridge_sample > 0 || atpg || compact_filename != NULL || dedupe) ) {
+    fprintf(stderr,"ERROR:  --dictionary indexes the patterns of pattern_file as read\n");
+    exit(-1);
+  }
+  if ( diag_filename != NULL && (bist.npatterns > 0 || weighted > 0 || frames > 0 ||
+				 estimate > 0 || multi_k > 0 || bridge_filename != NULL ||
+				 bridge_sample > 0 || atpg || compact_filename != NULL || dedupe ||
+				 test_points > 0 || dict_filename != NULL) ) {
+    fprintf(stderr,"ERROR:  --diagnose indexes the patterns of pattern_file as read\n");
+    exit(-1);
+  }
+  if ( verify && (bist.npatterns > 0 || weighted > 0 || frames > 0 || estimate > 0 ||
+		  multi_k > 0 || bridge_filename != NULL || bridge_sample > 0 || atpg ||
+		  compact_filename != NULL || dedupe || test_points > 0 || redundancy ||
+		  fault_sample > 0.0 || order || dict_filename != NULL ||
+		  diag_filename != NULL || fault_filename != NULL) ) {
+    fprintf(stderr,"ERROR:  --verify only good-simulates the patterns\n");
+    exit(-1);
+  }
+  if ( good_only && (bist.npatterns > 0 || weighted > 0 || frames > 0 || estimate > 0 ||
+		     multi_k > 0 || bridge_filename != NULL || bridge_sample > 0 || atpg ||
+		     compact_filename != NULL || dedupe || test_points > 0 || redundancy ||
+		     fault_sample > 0.0 || order || dict_filename != NULL ||
+		     diag_filename != NULL || verify || power_filename != NULL ||
+		     fault_filename != NULL) ) {
+    fprintf(stderr,"ERROR:  --good-only only good-simulates the patterns\n");
+    exit(-1);
+  }
+  if ( power_filename != NULL && (!parallel || bist.npatterns > 0 || weighted > 0 ||
+				  frames > 0 || estimate > 0 || multi_k > 0 ||
+				  bridge_filename != NULL || bridge_sample > 0 || order ||
+				  dedupe || verify || dict_filename != NULL ||
+				  diag_filename != NULL || mask_filename != NULL) ) {
+    fprintf(stderr,"ERROR:  --power counts the toggles of the --parallel engine\n");
+    exit(-1);
+  }
+  if ( mask_filename != NULL && !parallel && threads == 0 && dict_filename == NULL &&
+       diag_filename == NULL && !verify && !good_only && !order && bist.npatterns == 0 &&
+       weighted == 0 && frames == 0 && estimate == 0 && multi_k == 0 &&
+       bridge_filename == NULL && bridge_sample == 0 ) {
+    fprintf(stderr,"ERROR:  --po-mask needs a pattern-parallel engine, e.g. --parallel\n");
+    exit(-1);
+  }
+  if ( curve && (estimate > 0 || multi_k > 0 || bridge_filename != NULL ||
+		 bridge_sample > 0 || verify || good_only || diag_filename != NULL ||
+		 x_subsume) ) {
+    fprintf(stderr,"ERROR:  --curve needs single stuck-at simulation of every pattern\n");
+    exit(-1);
+  }
+  if ( curve && (order || frames > 0 || thread_patterns) ) {
+    fprintf(stderr,"ERROR:  --curve needs the first detecting pattern, not recorded by --order, --frames or --thread-patterns\n");
+    exit(-1);
+  }
+  if ( collapse_mode == COLLAPSE_DOM &&
+       (!(parallel || threads > 0 || order || weighted > 0) || bist.npatterns > 0 || frames > 0 ||
+	estimate > 0 || multi_k > 0 || bridge_filename != NULL || bridge_sample > 0 ||
+	dict_filename != NULL || diag_filename != NULL || verify || good_only) ) {
+    fprintf(stderr,"ERROR:  --collapse dom needs combinational stuck-at simulation by a pattern-parallel engine\n");
+    exit(-1);
+  }
+  if ( threads > 0 && (bist.npatterns > 0 || weighted > 0 || frames > 0 || estimate > 0 ||
+			multi_k > 0 || bridge_filename != NULL || bridge_sample > 0 || order ||
+			dict_filename != NULL || diag_filename != NULL || verify || good_only ||
+			power_filename != NULL) ) {
+    fprintf(stderr,"ERROR:  --threads simulates the stuck-at faults of pattern_file only\n");
+    exit(-1);
+  }
+  if ( thread_patterns && threads == 0 ) {
+    fprintf(stderr,"ERROR:  --thread-patterns needs --threads\n");
+    exit(-1);
+  }
+  if ( dedupe && (frames > 0 || estimate > 0) ) {
+    fprintf(stderr,"ERROR:  --dedupe needs patterns that are independent of their order\n");
+    exit(-1);
+  }
+  if ( i >= (argc-2) + own_patterns ) {
     print_usage();
     exit(-1);
   }
@@ -74,16 +507,30 @@ main (argc,argv)
   printf("\nReading Circuit:  %s\n\n",ckt_filename);
   read_circuit(ckt_file);
   fclose(ckt_file);
-  strcpy(pat_filename,argv[i]);
-  i++;
-  pat_file = fopen(pat_filename,"r");
-  if ( pat_file == (FILE *)NULL ) {
-    fprintf(stderr,"ERROR:  can't open %s for reading\n",pat_filename);
-    exit(-1);
+  pat_file = (FILE *)NULL;
+  if ( !own_patterns ) {
+    strcpy(pat_filename,argv[i]);
+    i++;
+    pat_file = fopen(pat_filename,"r");
+    if ( pat_file == (FILE *)NULL ) {
+      fprintf(stderr,"ERROR:  can't open %s for reading\n",pat_filename);
+      exit(-1);
+    }
+    /* streamed by verify_responses() or good_simulate() */
+    if ( !verify && !good_only ) {
+      printf("\nReading Patterns:  %s\n\n",pat_filename);
+      read_patterns(&ckt,pat_file);
+      fclose(pat_file);
+    }
+  }
+  /* pat holds the distinct patterns until expand_patterns() */
+  pattern_rep = (int *)NULL;
+  if ( dedupe && !own_patterns ) {
+    pattern_rep = dedupe_patterns(&ckt,&pat,&all_pat,x_subsume);
+  }
+  else if ( bist.npatterns > 0 ) {
+    bist_check(&bist);
   }
-  printf("\nReading Patterns:  %s\n\n",pat_filename);
-  read_patterns(&ckt,pat_file);
-  fclose(pat_file);
   strcpy(out_filename,argv[i]);
   i++;
   out_file = fopen(out_filename,"w");
@@ -91,8 +538,85 @@ main (argc,argv)
     fprintf(stderr,"ERROR:  can't open %s for writing\n",out_filename);
     exit(-1);
   }
-  flist = init_fault_list(&ckt);
-  for (num_faults = 0,ptr = flist; (ptr != (fault_list_t *)NULL); num_faults++, ptr = ptr->next);
+  dict_file = (FILE *)NULL;
+  if ( dict_filename != NULL ) {
+    dict_file = fopen(dict_filename,"wb");
+    if ( dict_file == (FILE *)NULL ) {
+      fprintf(stderr,"ERROR:  can't open %s for writing\n",dict_filename);
+      exit(-1);
+    }
+  }
+  power_file = (FILE *)NULL;
+  if ( power_filename != NULL ) {
+    power_file = fopen(power_filename,"w");
+    if ( power_file == (FILE *)NULL ) {
+      fprintf(stderr,"ERROR:  can't open %s for writing\n",power_filename);
+      exit(-1);
+    }
+  }
+  diag_file = (FILE *)NULL;
+  if ( diag_filename != NULL ) {
+    diag_file = fopen(diag_filename,"r");
+    if ( diag_file == (FILE *)NULL ) {
+      fprintf(stderr,"ERROR:  can't open %s for reading\n",diag_filename);
+      exit(-1);
+    }
+  }
+  /* no faults when only the good machine is simulated */
+  if ( verify || good_only ) {
+    init_io(&ckt);
+    flist = (fault_list_t *)NULL;
+  }
+  else if ( fault_filename != NULL ) {
+    fault_file = fopen(fault_filename,"r");
+    if ( fault_file == (FILE *)NULL ) {
+      fprintf(stderr,"ERROR:  can't open %s for reading\n",fault_filename);
+      exit(-1);
+    }
+    init_io(&ckt);
+    flist = read_fault_list(&ckt,fault_file);
+    fclose(fault_file);
+  }
+  else
+    flist = init_fault_list(&ckt);
+  /* needs ckt.po[] */
+  num_masked = 0;
+  if ( mask_filename != NULL ) {
+    mask_file = fopen(mask_filename,"r");
+    if ( mask_file == (FILE *)NULL ) {
+      fprintf(stderr,"ERROR:  can't open %s for reading\n",mask_filename);
+      exit(-1);
+    }
+    num_masked = read_po_mask(&ckt,mask_file);
+    fclose(mask_file);
+  }
+  if ( fault_sample > 0.0 ) {
+    flist = sample_fault_list(&ckt,flist,fault_sample);
+  }
+  /* the other modes report on every fault, or on no stuck-at faults; the
+     serial engine carries state from one fault to the next, so its results
+     depend on the list it is given */
+  collapsed = (collapse_mode != COLLAPSE_NONE) && estimate == 0 && multi_k == 0 &&
+    bridge_filename == NULL && bridge_sample == 0 && dict_filename == NULL &&
+    diag_filename == NULL && !verify && !good_only &&
+    (parallel || threads > 0 || order || bist.npatterns > 0 || weighted > 0 ||
+     frames > 0);
+  if ( collapsed ) {
+    flist = collapse_faults(&ckt,flist,collapse_mode == COLLAPSE_DOM,&collapse);
+  }
+  if ( redundancy ) {
+    getrusage(RUSAGE_SELF,&start_time);
+    flist = identify_redundant(&ckt,flist,&redundant_flist);
+    if ( collapsed )
+      redundant_flist = expand_faults(&collapse,redundant_flist,FALSE);
+    getrusage(RUSAGE_SELF,&finish_time);
+    time = ((finish_time.ru_utime.tv_sec*1e6)+finish_time.ru_utime.tv_usec)
+           - ((start_time.ru_utime.tv_sec*1e6)+start_time.ru_utime.tv_usec);
+    for (num_redundant = 0,ptr = redundant_flist; ptr != (fault_list_t *)NULL; num_redundant++, ptr = ptr->next);
+    printf("Redundancy Analysis Time = %f sec\n",(float)time/(float)1e6);
+  }
+  for (num_simulated = 0,ptr = flist; (ptr != (fault_list_t *)NULL); num_simulated++, ptr = ptr->next);
+  num_faults = collapsed ? collapse.nfaults : num_simulated+num_redundant;
   /*
   for (num_faults = 0,ptr = flist; (ptr != (fault_list_t *)NULL) && (num_faults < 10000); num_faults++) {
     ptr = ptr->next;
@@ -109,20 +633,201 @@ main (argc,argv)
   assert(ptr == (fault_list_t *)NULL);
   printf("Number of PI = %d\n",ckt.npi);
   printf("Number of PO = %d\n",ckt.npo);
+  if ( mask_filename != NULL )
+    printf("Number of masked PO = %d\n",num_masked);
+  if ( ckt.nlatch > 0 ) {
+    printf("Number of latches = %d (scanned, counted in PI and PO)\n",ckt.nlatch);
+  }
   printf("Number of gates = %d\n",ckt.ngates);
-  printf("Number of faults = %d\n",num_faults);
-  printf("Number of patterns = %d\n",pat.len);
+  if ( collapsed && collapse.ndropped > 0 )
+    printf("Number of faults = %d (%d simulated, %d classes implied by dominance)\n",
+	   num_faults,collapse.nclasses,collapse.ndropped);
+  else if ( collapsed )
+    printf("Number of faults = %d (%d simulated after collapsing)\n",num_faults,
+	   collapse.nclasses);
+  else if ( !verify && !good_only )
+    printf("Number of faults = %d\n",num_faults);
+  if ( redundancy )
+    printf("Number of redundant faults = %d (not simulated)\n",num_redundant);
+  if ( bist.npatterns > 0 )
+    printf("Number of BIST patterns = %llu\n",bist.npatterns);
+  else if ( weighted > 0 )
+    printf("Number of patterns = up to %d, generated\n",weighted);
+  else if ( verify || good_only )
+    ; /* counted by verify_responses() or good_simulate() */
+  else if ( pattern_rep != (int *)NULL )
+    printf("Number of patterns = %d (%d simulated)\n",all_pat.len,pat.len);
+  else
+    printf("Number of patterns = %d\n",pat.len);
+  blist = undetected_blist = (bridge_list_t *)NULL;
+  undetected_flist = (fault_list_t *)NULL;
+  power = (power_t *)NULL;
+  if ( bridge_filename != NULL ) {
+    bridge_file = fopen(bridge_filename,"r");
+    if ( bridge_file == (FILE *)NULL ) {
+      fprintf(stderr,"ERROR:  can't open %s for reading\n",bridge_filename);
+      exit(-1);
+    }
+    blist = read_bridge_list(&ckt,bridge_file);
+    fclose(bridge_file);
+  }
+  else if ( bridge_sample > 0 ) {
+    blist = sample_bridge_list(&ckt,bridge_sample,seed);
+  }
+  for (num_bridges = 0,bptr = blist; bptr != (bridge_list_t *)NULL; num_bridges++, bptr = bptr->next);
+  if ( bridge_filename != NULL || bridge_sample > 0 ) {
+    printf("Number of bridging faults = %d\n",num_bridges);
+  }
+  mlist = undetected_mlist = (multi_fault_t *)NULL;
+  if ( multi_k > 0 ) {
+    mlist = sample_multi_faults(flist,multi_k,multi_sample,seed);
+  }
+  for (num_tuples = 0,mptr = mlist; mptr != (multi_fault_t *)NULL; num_tuples++, mptr = mptr->next);
+  if ( multi_k > 0 ) {
+    printf("Number of %d-fault tuples = %d\n",multi_k,num_tuples);
+  }
+
+  if ( curve ) {
+    curve_faults = (fault_list_t **)malloc((num_faults+1)*sizeof(fault_list_t *));
+    for (i = 0,ptr = flist; ptr != (fault_list_t *)NULL; i++,ptr = ptr->next) {
+      curve_faults[i] = ptr;
+    }
+    num_curve_faults = i;
+  }
+
+  /* compaction re-simulates the whole list once the pattern set is final */
+  fault_array = (fault_list_t **)NULL;
+  if ( compact_filename != NULL ) {
+    fault_array = (fault_list_t **)malloc((num_faults+1)*sizeof(fault_list_t *));
+    for (i = 0,ptr = flist; ptr != (fault_list_t *)NULL; i++,ptr = ptr->next) {
+      fault_array[i] = ptr;
+    }
+    fault_array[i] = (fault_list_t *)NULL;
+  }
 
   printf("\nRunning Simulation...\n\n");
   getrusage(RUSAGE_SELF,&start_time);
-  undetected_flist = three_val_fault_simulate(&ckt,&pat,flist);
+  gettimeofday(&start_wall,NULL);
+  if ( estimate > 0 )
+    estimate_coverage(&ckt,&pat,flist,num_faults,estimate,estimate_sample,out_file);
+  else if ( bridge_filename != NULL || bridge_sample > 0 )
+    undetected_blist = bridge_fault_simulate(&ckt,&pat,blist);
+  else if ( multi_k > 0 ) {
+    undetected_mlist = multi_fault_simulate(&ckt,&pat,mlist);
+    /* single faults, to tell masking escapes apart */
+    undetected_flist = parallel_fault_simulate(&ckt,&pat,flist,(power_t *)NULL);
+  }
+  else if ( bist.npatterns > 0 )
+    undetected_flist = bist_fault_simulate(&ckt,&bist,flist,seed);
+  else if ( weighted > 0 )
+    undetected_flist = weighted_random_simulate(&ckt,&pat,flist,weighted,seed);
+  else if ( frames > 0 )
+    undetected_flist = sequential_fault_simulate(&ckt,&pat,flist,frames);
+  else if ( dict_filename != NULL ) {
+    undetected_flist = dictionary_simulate(&ckt,&pat,flist,dict_full,dict_file);
+    fclose(dict_file);
+  }
+  else if ( verify ) {
+    verify_responses(&ckt,pat_file,out_file);
+    fclose(pat_file);
+  }
+  else if ( good_only ) {
+    printf("Number of patterns = %lld\n\n",good_simulate(&ckt,pat_file,out_file));
+    fclose(pat_file);
+  }
+  else if ( diag_filename != NULL ) {
+    diagnose(&ckt,&pat,flist,diag_file,diag_candidates,out_file);
+    fclose(diag_file);
+  }
+  else if ( order )
+    undetected_flist = ordered_fault_simulate(&ckt,&pat,flist,order);
+  else if ( threads > 0 && thread_patterns )
+    undetected_flist = pattern_threaded_fault_simulate(&ckt,&pat,flist,threads);
+  else if ( threads > 0 )
+    undetected_flist = threaded_fault_simulate(&ckt,&pat,flist,threads);
+  else if ( parallel && power_filename != NULL ) {
+    power = power_create(&ckt,pat.len);
+    undetected_flist = parallel_fault_simulate(&ckt,&pat,flist,power);
+  }
+  else if ( parallel )
+    undetected_flist = parallel_fault_simulate(&ckt,&pat,flist,(power_t *)NULL);
+  else
+    undetected_flist = three_val_fault_simulate(&ckt,&pat,flist);
+  if ( pattern_rep != (int *)NULL ) {
+    if ( curve )
+      dedupe_detect_index(curve_faults,num_curve_faults,&all_pat,pattern_rep);
+    expand_patterns(&ckt,&pat,&all_pat,pattern_rep);
+  }
+  if ( atpg )
+    undetected_flist = atpg_top_off(&ckt,&pat,undetected_flist,backtracks,seed,&atpg_stats);
+  num_patterns = pat.len;
+  if ( compact_filename != NULL ) {
+    for (i = 0; fault_array[i] != (fault_list_t *)NULL; i++) {
+      fault_array[i]->next = fault_array[i+1];
+    }
+    undetected_flist = compact_patterns(&ckt,&pat,fault_array[0],greedy);
+    free(fault_array);
+  }
   getrusage(RUSAGE_SELF,&finish_time);
+  gettimeofday(&finish_wall,NULL);
   time = ((finish_time.ru_utime.tv_sec*1e6)+finish_time.ru_utime.tv_usec)
          - ((start_time.ru_utime.tv_sec*1e6)+start_time.ru_utime.tv_usec);
+  /* report on every fault, not just the simulated ones */
+  if ( collapsed ) {
+    undetected_flist = expand_faults(&collapse,undetected_flist,TRUE);
+    if ( curve ) {
+      free(curve_faults);
+      curve_faults = collapse.faults;
+      num_curve_faults = collapse.nfaults;
+    }
+  }
   printf("Finished Simulation.\n\n");
   printf("Simulation Time = %f sec\n\n",(float)time/(float)1e6);
+  if ( threads > 0 ) {
+    /* the user time above adds up over the threads */
+    printf("Simulation Wall Time = %f sec\n\n",
+	   (float)(((finish_wall.tv_sec-start_wall.tv_sec)*1e6)
+		   +(finish_wall.tv_usec-start_wall.tv_usec))/(float)1e6);
+  }
+  if ( compact_filename != NULL ) {
+    printf("Compacted Patterns = %d -> %d\n\n",num_patterns,pat.len);
+    write_pattern_file(&ckt,&pat,compact_filename);
+  }
+  if ( power != (power_t *)NULL ) {
+    power_write(power,power_file);
+    fclose(power_file);
+    power_free(power);
+    printf("\n");
+  }
+  if ( atpg ) {
+    printf("ATPG Patterns = %d\n",atpg_stats.patterns);
+    printf("Untestable Faults = %d, Aborted Faults = %d\n\n",
+	   atpg_stats.untestable,atpg_stats.aborted);
+  }
   printf("\nWriting Output:  %s\n\n",out_filename);
-  write_output(&ckt,&pat,undetected_flist,num_faults,out_file);
+  if ( estimate > 0 )
+    ; /* written by estimate_coverage() */
+  else if ( diag_filename != NULL || verify || good_only )
+    ; /* written by diagnose(), verify_responses() or good_simulate() */
+  else if ( bridge_filename != NULL || bridge_sample > 0 )
+    write_bridge_output(&ckt,&pat,undetected_blist,num_bridges,out_file);
+  else if ( multi_k > 0 )
+    write_multi_output(&ckt,&pat,undetected_mlist,num_tuples,undetected_flist,out_file);
+  else {
+    /* no patterns are listed in BIST mode, pat.len is 0 */
+    if ( bist.npatterns > 0 )
+      write_bist_signature(&bist,out_file);
+    write_output(&ckt,&pat,undetected_flist,num_faults,out_file);
+    if ( test_points > 0 ) {
+      for (i = num_redundant,ptr = undetected_flist; ptr != (fault_list_t *)NULL; i++, ptr = ptr->next);
+      getrusage(RUSAGE_SELF,&start_time);
+      test_point_analysis(&ckt,&pat,undetected_flist,num_faults,i,test_points,out_file);
+      getrusage(RUSAGE_SELF,&finish_time);
+      time = ((finish_time.ru_utime.tv_sec*1e6)+finish_time.ru_utime.tv_usec)
+	     - ((start_time.ru_utime.tv_sec*1e6)+start_time.ru_utime.tv_usec);
+      printf("Test Point Analysis Time = %f sec\n\n",(float)time/(float)1e6);
+    }
+  }
   fclose(out_file);
   /* free data structures */
   //free(fault_array);
@@ -169,18 +874,169 @@ void read_patterns(ckt,pat_file)
   }  /* end for */
 }  /* end read_patterns() */
 
+/* read the names of the primary outputs not to observe, one per line, into
+   ckt->po_mask; blank lines and lines starting with '#' are skipped */
+int read_po_mask(ckt,mask_file)
+     circuit_t *ckt;
+     FILE *mask_file; /* file already open and ready to read (don't close it) */
+{
+  char line[1024], name[1024];
+  int g, j, count, line_count;
+
+  ckt->po_mask = (char *)calloc(ckt->npo+1,sizeof(char));
+  count = line_count = 0;
+  while (fgets(line,sizeof(line),mask_file) != NULL) {
+    line_count++;
+    if ( sscanf(line,"%1023s",name) != 1 || name[0] == '#' )
+      continue;
+    g = Find_Gate(name,TRUE);
+    for (j = 0; j < ckt->npo && ckt->po[j] != g; j++);
+    if ( g < 0 || j == ckt->npo ) {
+      printf("Warning: skipping unknown output %s on line %d\n",name,line_count);
+      continue;
+    }
+    if ( !ckt->po_mask[j] )
+      count++;
+    ckt->po_mask[j] = TRUE;
+  }
+  return(count);
+}
+
+/* read the faults to simulate, one per line, either as "name pin S_A_v"
+   or as write_fault() writes them, into a list in file order; a PO gate
+   is named with a "(PO)" token, since it shares the name of its driver.
+   Blank lines and lines starting with '#' are skipped, as are repeated
+   faults and faults on unknown gates or pins */
+fault_list_t *read_fault_list(ckt,fault_file)
+     circuit_t *ckt;
+     FILE *fault_file; /* file already open and ready to read (don't close it) */
+{
+  char line[1024], tok[8][1024], *name, *pin, *val;
+  char *seen;
+  int g, k, n, ntok, po, input_index, nfanin, line_count;
+  stuck_val_t type;
+  fault_list_t *flist, *reversed, *next;
+
+  seen = (char *)calloc(ckt->ngates+1,sizeof(char));
+  flist = (fault_list_t *)NULL;
+  line_count = 0;
+  while (fgets(line,sizeof(line),fault_file) != NULL) {
+    line_count++;
+    ntok = sscanf(line,"%1023s %1023s %1023s %1023s %1023s %1023s %1023s %1023s",
+		  tok[0],tok[1],tok[2],tok[3],tok[4],tok[5],tok[6],tok[7]);
+    if ( ntok <= 0 || tok[0][0] == '#' )
+      continue;
+    /* pick the name, pin and value out of either form */
+    k = (strcmp(tok[0],"Gate") == 0) ? 1 : 0;
+    name = (k < ntok) ? tok[k] : NULL;
+    pin = val = NULL;
+    po = FALSE;
+    for (k++; k < ntok; k++) {
+      if ( strncmp(tok[k],"(PO)",4) == 0 )
+	po = TRUE;
+      else if ( strncmp(tok[k],"output",6) == 0 || strncmp(tok[k],"input",5) == 0 )
+	pin = tok[k];
+      else if ( strncmp(tok[k],"S_A_",4) == 0 )
+	val = tok[k];
+    }
+    g = (name != NULL) ? Find_Gate(name,po) : -1;
+    if ( g < 0 || pin == NULL || val == NULL || (val[4] != '0' && val[4] != '1') ) {
+      printf("Warning: skipping unknown fault on line %d\n",line_count);
+      continue;
+    }
+    type = (val[4] == '0') ? S_A_0 : S_A_1;
+    switch ( ckt->gate[g].type ) {
+    case AND: case NAND: case OR: case NOR:
+      nfanin = 2;
+      break;
+    case INV: case BUF: case PO:
+      nfanin = 1;
+      break;
+    default:
+      nfanin = 0;
+      break;
+    }
+    input_index = -1;
+    if ( pin[0] == 'i' && sscanf(pin+5,"%d",&n) == 1 )
+      input_index = n;
+    if ( (pin[0] == 'i' && (input_index < 0 || input_index >= nfanin)) ||
+	 (pin[0] == 'o' && (ckt->gate[g].type == PO || ckt->gate[g].type == PO_GND ||
+			    ckt->gate[g].type == PO_VCC)) ) {
+      printf("Warning: skipping fault on missing pin %s of %s on line %d\n",
+	     pin,name,line_count);
+      continue;
+    }
+    /* one bit per pin and value */
+    k = 1 << (2*(input_index+1) + type);
+    if ( seen[g] & k )
+      continue;
+    seen[g] |= k;
+    flist = add_fault(flist,g,input_index,type);
+  }
+  free(seen);
+  /* add_fault() prepends */
+  for (reversed = (fault_list_t *)NULL; flist != (fault_list_t *)NULL; flist = next) {
+    next = flist->next;
+    flist->next = reversed;
+    reversed = flist;
+  }
+  return(reversed);
+}
+
 int fcount = 0;
 
-fault_list_t *init_fault_list(ckt)
+/* set up ckt->pi[] and ckt->po[] */
+void init_io(ckt)
      circuit_t *ckt;
 {
-  fault_list_t *flist;
   int i,j;
-  int pi_count = 0;
   int po_count = 0;
 
+  /* constant nodes are entered in po[] as well, though npo does not
+     count them */
+  for (i = 0, j = 0; i < ckt->ngates; i++) {
+    if ( (ckt->gate[i].type == PO_GND) || (ckt->gate[i].type == PO_VCC) )
+      j++;
+  }
   ckt->pi = (int *)malloc(ckt->npi*sizeof(int));
-  ckt->po = (int *)malloc(ckt->npo*sizeof(int));
+  ckt->po = (int *)malloc((ckt->npo+j)*sizeof(int));
+  /* a PI that reaches no PO is dropped by the levelizer; its column of the
+     pattern file is read but not simulated.  The reference simulator that
+     wrote data/s13207.gold.out left such entries at 0, so the columns of
+     the five unconnected PIs of s13207 overwrote gate 0 (g3), the last one
+     winning; that file differs from ours where g3 and column 645 differ */
+  for (j = 0; j < ckt->npi; j++) {
+    ckt->pi[j] = -1;
+  }
+  for (i = 0; i < ckt->ngates; i++) {
+    switch ( ckt->gate[i].type ) {
+    case PI:
+      for (j = 0; j < ckt->npi; j++) {
+	if ( strcmp(pi_order_name_array[j],ckt->gate[i].name) == 0 ) {
+	  ckt->pi[j] = i;
+	}
+      }
+      break;
+    case PO:
+    case PO_GND:
+    case PO_VCC:
+      ckt->po[po_count] = i;
+      po_count++;
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+fault_list_t *init_fault_list(ckt)
+     circuit_t *ckt;
+{
+  fault_list_t *flist;
+  int i;
+  int pi_count = 0;
+
+  init_io(ckt);
   flist = (fault_list_t *)NULL;
   for (i = 0; (i < ckt->ngates) ; i++) {
     switch ( ckt->gate[i].type ) {
@@ -207,11 +1063,6 @@ fault_list_t *init_fault_list(ckt)
       fcount += 2;
       break;
     case PI:
-      for (j = 0; j < ckt->npi; j++) {
-	if ( strcmp(pi_order_name_array[j],ckt->gate[i].name) == 0 ) {
-	  ckt->pi[j] = i;
-	}
-      }
       /* ckt->pi[pi_count] = i; */
       pi_count++;
       flist = add_fault(flist,i,-1,S_A_0);
@@ -219,16 +1070,12 @@ fault_list_t *init_fault_list(ckt)
       fcount += 2;
       break;
     case PO:
-      ckt->po[po_count] = i;
-      po_count++;
       flist = add_fault(flist,i,0,S_A_0);
       flist = add_fault(flist,i,0,S_A_1);
       fcount += 2;
       break;
     case PO_GND:
     case PO_VCC:
-      ckt->po[po_count] = i;
-      po_count++;
       break;
     default:
       printf("ERROR:  Unknown gate!\n");
@@ -255,19 +1102,64 @@ fault_list_t *add_fault(flist,gate_index,input_index,type)
   new_fault->gate_index = gate_index;
   new_fault->input_index = input_index;
   new_fault->type = type;
+  new_fault->detect_index = -1;
   new_fault->next = flist;
   return(new_fault);
 }
 
-void write_output(ckt,pat,flist,num_faults,out_file)
+/* keep a uniformly random fraction of the faults of every gate type (at
+   least two of a type that has two), in list order; the rest are freed */
+fault_list_t *sample_fault_list(ckt,flist,fraction)
      circuit_t *ckt;
-     pattern_t *pat;
      fault_list_t *flist;
-     int num_faults;
+     double fraction;
+{
+  int seen[UNKNOWN+1], kept[UNKNOWN+1];
+  int h;
+  double u;
+  word_t state;
+  fault_list_t *ptr, *next, *sample, **tail;
+
+  for (h = 0; h <= UNKNOWN; h++) {
+    stratum_size[h] = stratum_sample[h] = seen[h] = kept[h] = 0;
+  }
+  for (ptr = flist; ptr != (fault_list_t *)NULL; ptr = ptr->next) {
+    stratum_size[ckt->gate[ptr->gate_index].type]++;
+  }
+  for (h = 0; h <= UNKNOWN; h++) {
+    stratum_sample[h] = (int)(fraction*stratum_size[h]+0.5);
+    if ( stratum_sample[h] < 2 )
+      stratum_sample[h] = (stratum_size[h] < 2) ? stratum_size[h] : 2;
+  }
+  /* selection sampling: keep a fault with probability
+     (still needed)/(still to be seen) within its gate type */
+  state = (seed != 0) ? seed : 1;
+  sample = (fault_list_t *)NULL;
+  tail = &sample;
+  for (ptr = flist; ptr != (fault_list_t *)NULL; ptr = next) {
+    next = ptr->next;
+    h = ckt->gate[ptr->gate_index].type;
+    u = (double)(psim_random(&state) >> 11)/9007199254740992.0; /* [0,1) */
+    if ( u*(stratum_size[h]-seen[h]) < stratum_sample[h]-kept[h] ) {
+      *tail = ptr;
+      tail = &ptr->next;
+      kept[h]++;
+    }
+    else {
+      free(ptr);
+    }
+    seen[h]++;
+  }
+  *tail = (fault_list_t *)NULL;
+  return (sample);
+}
+
+void write_patterns(ckt,pat,out_file)
+     circuit_t *ckt;
+     pattern_t *pat;
      FILE *out_file;
 {
-  int i,j,count;
-  fault_list_t *ptr;
+  int i,j;
 
   for (i = 0; i < pat->len; i++) {
     for (j = 0; j < ckt->npi; j++) {
@@ -279,6 +1171,42 @@ void write_output(ckt,pat,flist,num_faults,out_file)
     }
     fprintf(out_file,"\n");
   }
+}
+
+/* write the input patterns in pattern file format */
+void write_pattern_file(ckt,pat,filename)
+     circuit_t *ckt;
+     pattern_t *pat;
+     char *filename;
+{
+  FILE *pat_file;
+  int i,j;
+
+  pat_file = fopen(filename,"w");
+  if ( pat_file == (FILE *)NULL ) {
+    fprintf(stderr,"ERROR:  can't open %s for writing\n",filename);
+    exit(-1);
+  }
+  for (i = 0; i < pat->len; i++) {
+    for (j = 0; j < ckt->npi; j++) {
+      fprintf(pat_file,"%d",pat->in[i][j]);
+    }
+    fprintf(pat_file,"\n");
+  }
+  fclose(pat_file);
+}
+
+void write_output(ckt,pat,flist,num_faults,out_file)
+     circuit_t *ckt;
+     pattern_t *pat;
+     fault_list_t *flist;
+     int num_faults;
+     FILE *out_file;
+{
+  int count;
+  fault_list_t *ptr;
+
+  write_patterns(ckt,pat,out_file);
   fprintf(out_file,"\nList of Undetected Faults:\n");
   if ( flist == (fault_list_t *)NULL ) {
     fprintf(out_file,"(Empty)\n");
@@ -286,54 +1214,166 @@ void write_output(ckt,pat,flist,num_faults,out_file)
   count = 0;
   for (ptr = flist; ptr != (fault_list_t *)NULL; ptr = ptr->next) {
     count++;
-    fprintf(out_file,"Gate %s ",ckt->gate[ptr->gate_index].name);
-    switch (ckt->gate[ptr->gate_index].type) {
-    case AND:
-      fprintf(out_file,"(AND) ");
-      break;
-    case OR:
-      fprintf(out_file,"(OR)  ");
-      break;
-    case NAND:
-      fprintf(out_file,"(NAND)");
-      break;
-    case NOR:
-      fprintf(out_file,"(NOR) ");
-      break;
-    case INV:
-      fprintf(out_file,"(INV) ");
-      break;
-    case BUF:
-      fprintf(out_file,"(BUF) ");
-      break;
-    case PO:
-      fprintf(out_file,"(PO)  ");
-      break;
-    case PI:
-      fprintf(out_file,"(PI)  ");
-      break;
-    case PO_GND:
-      fprintf(out_file,"(PO_GND)");
-      break;
-    case PO_VCC:
-      fprintf(out_file,"(PO_VCC)");
-      break;
-    default:
-      fprintf(out_file,"(UNKNOWN)");
-      break;
+    write_fault(ckt,ptr,out_file);
+  }
+  if ( redundancy ) {
+    fprintf(out_file,"\nList of Redundant Faults:\n");
+    if ( redundant_flist == (fault_list_t *)NULL ) {
+      fprintf(out_file,"(Empty)\n");
     }
-    if ( ptr->input_index < 0 ) {
-      fprintf(out_file,"- output, ");
+    for (ptr = redundant_flist; ptr != (fault_list_t *)NULL; ptr = ptr->next) {
+      write_fault(ckt,ptr,out_file);
     }
-    else {
-      fprintf(out_file,"- input%d (%s), ",ptr->input_index,
-         ckt->gate[ckt->gate[ptr->gate_index].fanin[ptr->input_index]].name);
-    }
-    fprintf(out_file,"%s\n",(ptr->type == S_A_0) ? "S_A_0" : "S_A_1");
   }
   fprintf(out_file,"\nTotal Number of Faults = %d\n",num_faults);
   fprintf(out_file,"Number of Undetected Faults = %d\n",count);
-  fprintf(out_file,"Fault Coverage = %d.%d%%\n\n",
+  if ( redundancy ) {
+    fprintf(out_file,"Number of Redundant Faults = %d\n",num_redundant);
+    count += num_redundant;
+  }
+  fprintf(out_file,"Fault Coverage = %d.%d%%\n",
 	  ((num_faults-count)*100)/num_faults,
 	  ((num_faults-count)*1000/num_faults)%10);
+  if ( redundancy ) {
+    /* detected or proven redundant */
+    count -= num_redundant;
+    fprintf(out_file,"Fault Efficiency = %d.%d%%\n",
+	    ((num_faults-count)*100)/num_faults,
+	    ((num_faults-count)*1000/num_faults)%10);
+  }
+  if ( collapse.ndropped > 0 ) {
+    /* only detected through the faults they dominate */
+    fprintf(out_file,"Fault Coverage is a lower bound (%d classes implied by dominance)\n",
+	    collapse.ndropped);
+  }
+  if ( fault_sample > 0.0 ) {
+    write_sample_estimate(ckt,flist,out_file);
+  }
+  if ( curve ) {
+    write_coverage_curve(num_faults,out_file);
+  }
+  fprintf(out_file,"\n");
+}
+
+/* cumulative coverage after every pattern that is the first to detect some
+   fault, from the detect_index of the simulated faults */
+void write_coverage_curve(num_faults,out_file)
+     int num_faults;
+     FILE *out_file;
+{
+  int *first_detects;
+  int i,n,total;
+
+  for (n = 0, i = 0; i < num_curve_faults; i++) {
+    if ( curve_faults[i]->detect_index >= n )
+      n = curve_faults[i]->detect_index+1;
+  }
+  first_detects = (int *)calloc(n+1,sizeof(int));
+  for (i = 0; i < num_curve_faults; i++) {
+    if ( curve_faults[i]->detect_index >= 0 )
+      first_detects[curve_faults[i]->detect_index]++;
+  }
+  fprintf(out_file,"\nCoverage Curve (patterns, detected faults, fault coverage):\n");
+  for (total = 0, i = 0; i < n; i++) {
+    if ( first_detects[i] == 0 )
+      continue;
+    total += first_detects[i];
+    fprintf(out_file,"%d %d %d.%d%%\n",i+1,total,
+	    (int)(((long long)total*100)/num_faults),
+	    (int)((((long long)total*1000)/num_faults)%10));
+  }
+  free(first_detects);
+}
+
+/* stratified estimate of the coverage of the whole fault universe from the
+   undetected faults of the sample, with a 95% confidence interval */
+void write_sample_estimate(ckt,flist,out_file)
+     circuit_t *ckt;
+     fault_list_t *flist;
+     FILE *out_file;
+{
+  int undetected[UNKNOWN+1];
+  int h,total,sampled;
+  double w,p,est,var;
+  fault_list_t *ptr;
+
+  for (h = 0; h <= UNKNOWN; h++) {
+    undetected[h] = 0;
+  }
+  for (ptr = flist; ptr != (fault_list_t *)NULL; ptr = ptr->next) {
+    undetected[ckt->gate[ptr->gate_index].type]++;
+  }
+  for (ptr = redundant_flist; ptr != (fault_list_t *)NULL; ptr = ptr->next) {
+    undetected[ckt->gate[ptr->gate_index].type]++;
+  }
+  for (total = 0, sampled = 0, h = 0; h <= UNKNOWN; h++) {
+    total += stratum_size[h];
+    sampled += stratum_sample[h];
+  }
+  est = var = 0.0;
+  for (h = 0; h <= UNKNOWN; h++) {
+    if ( stratum_sample[h] == 0 )
+      continue;
+    w = (double)stratum_size[h]/total;
+    p = (double)(stratum_sample[h]-undetected[h])/stratum_sample[h];
+    est += w*p;
+    if ( stratum_sample[h] > 1 )
+      var += w*w*(1.0-(double)stratum_sample[h]/stratum_size[h])*
+	p*(1.0-p)/(stratum_sample[h]-1);
+  }
+  fprintf(out_file,"Fault Sample = %d of %d faults, seed %lu\n",
+	  sampled,total,seed);
+  fprintf(out_file,"Estimated Fault Coverage = %.1f%% +/- %.2f%% (95%% confidence)\n",
+	  100.0*est,100.0*1.96*sqrt(var));
+}
+
+void write_fault(ckt,ptr,out_file)
+     circuit_t *ckt;
+     fault_list_t *ptr;
+     FILE *out_file;
+{
+  fprintf(out_file,"Gate %s ",ckt->gate[ptr->gate_index].name);
+  switch (ckt->gate[ptr->gate_index].type) {
+  case AND:
+    fprintf(out_file,"(AND) ");
+    break;
+  case OR:
+    fprintf(out_file,"(OR)  ");
+    break;
+  case NAND:
+    fprintf(out_file,"(NAND)");
+    break;
+  case NOR:
+    fprintf(out_file,"(NOR) ");
+    break;
+  case INV:
+    fprintf(out_file,"(INV) ");
+    break;
+  case BUF:
+    fprintf(out_file,"(BUF) ");
+    break;
+  case PO:
+    fprintf(out_file,"(PO)  ");
+    break;
+  case PI:
+    fprintf(out_file,"(PI)  ");
+    break;
+  case PO_GND:
+    fprintf(out_file,"(PO_GND)");
+    break;
+  case PO_VCC:
+    fprintf(out_file,"(PO_VCC)");
+    break;
+  default:
+    fprintf(out_file,"(UNKNOWN)");
+    break;
+  }
+  if ( ptr->input_index < 0 ) {
+    fprintf(out_file,"- output, ");
+  }
+  else {
+    fprintf(out_file,"- input%d (%s), ",ptr->input_index,
+       ckt->gate[ckt->gate[ptr->gate_index].fanin[ptr->input_index]].name);
+  }
+  fprintf(out_file,"%s\n",(ptr->type == S_A_0) ? "S_A_0" : "S_A_1");
 }
@@ -0,0 +1,244 @@
+#include "project.h"
+#include "psim.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*
+ * Multiple stuck-at fault simulation.
+ *
+ * Tuples of stuck-at faults from the single-fault universe are present at
+ * the same time.  The tuples are simulated fault-parallel: for one pattern
+ * the good values are broadcast to every lane and each lane carries one
+ * multiple-fault machine, so a single propagation covers WORD_BITS tuples.
+ */
+
+extern void write_patterns(); /* defined in main.c */
+extern void write_fault();
+
+/* TRUE if faults a and b sit on the same line */
+#define same_site(a, b) \
+  (((a)->gate_index == (b)->gate_index) && ((a)->input_index == (b)->input_index))
+
+/*************************************************************************
+
+Function:  sample_multi_faults
+
+Purpose:  Draws "ntuples" tuples of "k" stuck-at faults uniformly from
+flist.  The faults of a tuple sit on distinct lines; if 100 draws give
+no free line, the next fault on one is taken.  Exits if the faults sit
+on fewer than "k" lines.
+
+Return:  List of sampled tuples.
+
+*************************************************************************/
+
+multi_fault_t *sample_multi_faults(fault_list_t *flist, int k, int ntuples,
+                                   unsigned long seed)
+{
+  multi_fault_t *mlist, *mptr;
+  fault_list_t **faults;
+  int nfaults, n, i, j, tries, start;
+  word_t state;
+
+  faults = psim_fault_array(flist, &nfaults);
+  if (k < 1 || nfaults < k)
+  {
+    free(faults);
+    return ((multi_fault_t *)NULL);
+  }
+
+  state = (seed != 0) ? seed : 1;
+  mlist = (multi_fault_t *)NULL;
+  for (n = 0; n < ntuples; n++)
+  {
+    mptr = (multi_fault_t *)malloc(sizeof(multi_fault_t));
+    mptr->nfaults = k;
+    mptr->fault = (fault_list_t **)malloc(k * sizeof(fault_list_t *));
+    for (i = 0; i < k; i++)
+    {
+      for (tries = 0; tries < 100; tries++)
+      {
+        mptr->fault[i] = faults[psim_random(&state) % (word_t)nfaults];
+        for (j = 0; j < i; j++)
+          if (same_site(mptr->fault[i], mptr->fault[j]))
+            break;
+        if (j == i)
+          break;
+      }
+      if (j == i)
+        continue;
+      /* lines are scarce: take the next fault on a free one */
+      start = psim_random(&state) % (word_t)nfaults;
+      for (tries = 0; j < i && tries < nfaults; tries++)
+      {
+        mptr->fault[i] = faults[(start + tries) % nfaults];
+        for (j = 0; j < i; j++)
+          if (same_site(mptr->fault[i], mptr->fault[j]))
+            break;
+      }
+      if (j < i)
+      {
+        fprintf(stderr, "ERROR:  the faults sit on fewer than %d lines\n", k);
+        exit(-1);
+      }
+    }
+    mptr->next = mlist;
+    mlist = mptr;
+  }
+  free(faults);
+  return (mlist);
+}
+
+/*************************************************************************
+
+Function:  multi_fault_simulate
+
+Purpose:  Simulates the tuples in undetected_mlist against the patterns.
+Good values are computed WORD_BITS patterns at a time; then, pattern by
+pattern, the live tuples are packed WORD_BITS to a word and propagated
+together.  Tuples are dropped once detected.
+
+pat.out[][] is filled with the fault-free output patterns corresponding to
+the input patterns in pat.in[][].
+
+Return:  List of tuples that remain undetected, in their original order.
+
+*************************************************************************/
+
+multi_fault_t *multi_fault_simulate(circuit_t *ckt, pattern_t *pat,
+                                    multi_fault_t *undetected_mlist)
+{
+  psim_t *good, *ps;
+  multi_fault_t *mptr, **tuples;
+  inject_t *inj;
+  char *detected;
+  int *live;
+  int ntuples, nlive, kmax, t, w, m, k, j, ninj, first, p;
+  word_t detect;
+
+  LIST_TO_ARRAY(undetected_mlist, mptr, tuples, ntuples);
+  detected = (char *)calloc(ntuples + 1, sizeof(char));
+  live = (int *)malloc((ntuples + 1) * sizeof(int));
+  for (kmax = 1, t = 0; t < ntuples; t++)
+  {
+    live[t] = t;
+    if (tuples[t]->nfaults > kmax)
+      kmax = tuples[t]->nfaults;
+  }
+  inj = (inject_t *)malloc(WORD_BITS * kmax * sizeof(inject_t));
+  nlive = ntuples;
+
+  good = psim_create(ckt);
+  ps = psim_create(ckt);
+  for (first = 0; first < pat->len; first += WORD_BITS)
+  {
+    psim_load_patterns(good, pat, first);
+    psim_good_eval(good);
+    psim_store_outputs(good, pat, first);
+    for (p = 0; p < WORD_BITS && (good->valid & LANE(p)) && nlive > 0; p++)
+    {
+      psim_broadcast(ps, good, p);
+      for (w = 0; w < nlive; w += WORD_BITS)
+      {
+        m = (nlive - w < WORD_BITS) ? nlive - w : WORD_BITS;
+        ninj = 0;
+        for (k = 0; k < m; k++)
+        {
+          mptr = tuples[live[w + k]];
+          for (j = 0; j < mptr->nfaults; j++)
+          {
+            psim_fault_inject(mptr->fault[j], &inj[ninj]);
+            inj[ninj++].lanes = LANE(k);
+          }
+        }
+        ps->valid = (m == WORD_BITS) ? ALL_ONES : LANE(m) - 1;
+        detect = psim_propagate(ps, inj, ninj);
+        for (; detect != 0; detect &= detect - 1)
+          detected[live[w + lowest_lane(detect)]] = TRUE;
+      }
+      /* drop detected tuples */
+      for (t = 0, w = 0; t < nlive; t++)
+      {
+        if (!detected[live[t]])
+          live[w++] = live[t];
+      }
+      nlive = w;
+    }
+  }
+  psim_free(good);
+  psim_free(ps);
+
+  UNLINK_DETECTED(undetected_mlist, tuples, detected, ntuples);
+  free(tuples);
+  free(detected);
+  free(live);
+  free(inj);
+  return (undetected_mlist);
+}
+
+static int compare_fault_ptr(const void *a, const void *b)
+{
+  fault_list_t *fa = *(fault_list_t **)a, *fb = *(fault_list_t **)b;
+
+  return ((fa < fb) ? -1 : (fa > fb));
+}
+
+/*************************************************************************
+
+Function:  write_multi_output
+
+Purpose:  Writes the patterns and the tuples that escape them.  A tuple
+whose members are each detected on their own (undetected_flist holds the
+single faults the patterns miss) is a masking escape and is marked so.
+
+*************************************************************************/
+
+void write_multi_output(circuit_t *ckt, pattern_t *pat, multi_fault_t *mlist,
+                        int num_tuples, fault_list_t *undetected_flist,
+                        FILE *out_file)
+{
+  multi_fault_t *ptr;
+  fault_list_t **missed;
+  int count, masked, nmissed, j;
+
+  missed = psim_fault_array(undetected_flist, &nmissed);
+  qsort(missed, nmissed, sizeof(fault_list_t *), compare_fault_ptr);
+
+  write_patterns(ckt, pat, out_file);
+  fprintf(out_file, "\nList of Undetected Multiple Faults:\n");
+  if (mlist == (multi_fault_t *)NULL)
+    fprintf(out_file, "(Empty)\n");
+  count = 0;
+  masked = 0;
+  for (ptr = mlist; ptr != (multi_fault_t *)NULL; ptr = ptr->next)
+  {
+    count++;
+    /* is every member detected as a single fault? */
+    for (j = 0; j < ptr->nfaults; j++)
+    {
+      if (bsearch(&ptr->fault[j], missed, nmissed, sizeof(fault_list_t *),
+                  compare_fault_ptr) != NULL)
+        break;
+    }
+    if (j == ptr->nfaults)
+      masked++;
+    fprintf(out_file, "Multiple Fault %d%s\n", count,
+            (j == ptr->nfaults) ? " (masked, each fault detected alone)" : "");
+    for (j = 0; j < ptr->nfaults; j++)
+    {
+      fprintf(out_file, "  ");
+      write_fault(ckt, ptr->fault[j], out_file);
+    }
+  }
+  fprintf(out_file, "\nTotal Number of Multiple Faults = %d\n", num_tuples);
+  fprintf(out_file, "Number of Undetected Multiple Faults = %d\n", count);
+  fprintf(out_file, "Number Masked (all members detected alone) = %d\n", masked);
+  if (num_tuples > 0)
+    fprintf(out_file, "Multiple Fault Coverage = %d.%d%%\n\n",
+            ((num_tuples - count) * 100) / num_tuples,
+            ((num_tuples - count) * 1000 / num_tuples) % 10);
+  free(missed);
+}
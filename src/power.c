@@ -0,0 +1,211 @@
+#include "project.h"
+#include "psim.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*
+ * Test power from the toggles of the good machine.
+ *
+ * A gate toggles in a pattern when its value there is the opposite binary
+ * value of the previous pattern; X values never count.  Shifting the value
+ * words of a block up by one lane lines every pattern up with the one
+ * before, so one XOR-like step finds the toggles of all 64 patterns of a
+ * gate.  Each toggle is weighted by the gate's load, its fanout count.
+ *
+ * The weighted sums per pattern are kept in bit-sliced counters: slice b
+ * holds bit b of the running sum of every lane.  The gates of equal weight
+ * form a class, and a toggle word is added into a 4-bit counter kept for
+ * its class, with a fixed chain of half adders and no branch.  After 15
+ * words a counter is multiplied by the class weight, added into the wide
+ * slices, and cleared.  No per-lane work is done until the 64 sums are read
+ * out at the end of the block.
+ */
+
+#define POWER_SLICES 48 /* bits of a per-pattern sum */
+#define NARROW_MAX 15   /* words a 4-bit counter holds */
+
+/* add the 4-bit counter narrow[] times "w" into slice[], clear narrow[] and
+   return the number of slices in use */
+static int flush_narrow(word_t *slice, word_t *narrow, int w, int top)
+{
+  word_t x, s, carry;
+  int b, k;
+
+  for (b = 0; w != 0; w >>= 1, b++)
+  {
+    if (!(w & 1))
+      continue;
+    for (carry = 0, k = b; k < b + 4 || carry != 0; k++)
+    {
+      assert(k < POWER_SLICES);
+      x = (k < b + 4) ? narrow[k - b] : 0;
+      s = slice[k];
+      slice[k] = s ^ x ^ carry;
+      carry = (s & x) | (carry & (s ^ x));
+    }
+    if (k > top)
+      top = k;
+  }
+  narrow[0] = narrow[1] = narrow[2] = narrow[3] = 0;
+  return (top);
+}
+
+/*************************************************************************
+
+Function:  power_create
+
+Purpose:  Sets up the switching activity of up to "npatterns" patterns,
+counted block by block with power_block().
+
+*************************************************************************/
+
+power_t *power_create(circuit_t *ckt, int npatterns)
+{
+  power_t *pw;
+  int g, c;
+
+  pw = (power_t *)calloc(1, sizeof(power_t));
+  pw->weight = (int *)malloc((ckt->ngates + 1) * sizeof(int));
+  pw->wclass = (int *)malloc((ckt->ngates + 1) * sizeof(int));
+  pw->class_weight = (int *)malloc((ckt->ngates + 1) * sizeof(int));
+  for (g = 0; g < ckt->ngates; g++)
+  {
+    pw->weight[g] = (ckt->gate[g].num_fanout > 0) ? ckt->gate[g].num_fanout : 1;
+    for (c = 0; c < pw->nclasses; c++)
+    {
+      if (pw->class_weight[c] == pw->weight[g])
+        break;
+    }
+    if (c == pw->nclasses)
+      pw->class_weight[pw->nclasses++] = pw->weight[g];
+    pw->wclass[g] = c;
+  }
+  pw->narrow = (word_t *)calloc(4 * (pw->nclasses + 1), sizeof(word_t));
+  pw->count = (int *)calloc(pw->nclasses + 1, sizeof(int));
+  pw->last_zero = (word_t *)calloc(ckt->ngates + 1, sizeof(word_t));
+  pw->last_one = (word_t *)calloc(ckt->ngates + 1, sizeof(word_t));
+  pw->pattern_wsa = (long long *)calloc(npatterns + 1, sizeof(long long));
+  return (pw);
+}
+
+/*************************************************************************
+
+Function:  power_block
+
+Purpose:  Counts the toggles of the block just good simulated in ps, which
+must hold the patterns that follow those already counted.
+
+*************************************************************************/
+
+void power_block(power_t *pw, psim_t *ps)
+{
+  circuit_t *ckt = ps->ckt;
+  word_t slice[POWER_SLICES], valid, z, o, t, c, x, *narrow;
+  long long sum;
+  int g, k, top, p, n;
+
+  if (pw->level_wsa == NULL)
+  {
+    pw->nlevels = ps->nlevels;
+    pw->level_wsa = (long long *)calloc(pw->nlevels + 1, sizeof(long long));
+  }
+  /* the very first pattern has nothing to toggle from */
+  valid = ps->valid;
+  if (pw->npatterns == 0)
+    valid &= ~LANE(0);
+  memset(slice, 0, sizeof(slice));
+  top = 0;
+  for (g = 0; g < ckt->ngates; g++)
+  {
+    z = ps->zero[g];
+    o = ps->one[g];
+    t = ((z & ((o << 1) | pw->last_one[g])) |
+         (o & ((z << 1) | pw->last_zero[g]))) &
+        valid;
+    pw->last_zero[g] = z >> (WORD_BITS - 1);
+    pw->last_one[g] = o >> (WORD_BITS - 1);
+    if (t == 0)
+      continue;
+    pw->level_wsa[ps->level[g]] += (long long)pw->weight[g] * popcount(t);
+    narrow = pw->narrow + 4 * pw->wclass[g];
+    x = narrow[0] & t;
+    narrow[0] ^= t;
+    c = narrow[1] & x;
+    narrow[1] ^= x;
+    x = narrow[2] & c;
+    narrow[2] ^= c;
+    narrow[3] ^= x;
+    if (++pw->count[pw->wclass[g]] == NARROW_MAX)
+    {
+      top = flush_narrow(slice, narrow, pw->weight[g], top);
+      pw->count[pw->wclass[g]] = 0;
+    }
+  }
+  for (k = 0; k < pw->nclasses; k++)
+  {
+    if (pw->count[k] > 0)
+      top = flush_narrow(slice, pw->narrow + 4 * k, pw->class_weight[k], top);
+    pw->count[k] = 0;
+  }
+
+  /* read out the sums */
+  n = popcount(ps->valid);
+  for (p = 0; p < n; p++)
+  {
+    for (sum = 0, k = 0; k < top; k++)
+      sum |= (long long)((slice[k] >> p) & 1) << k;
+    pw->pattern_wsa[pw->npatterns + p] = sum;
+  }
+  pw->npatterns += n;
+}
+
+/*************************************************************************
+
+Function:  power_write
+
+Purpose:  Writes the weighted switching activity of every pattern and of
+every level to power_file, and prints the peak pattern.
+
+*************************************************************************/
+
+void power_write(power_t *pw, FILE *power_file)
+{
+  long long total;
+  int p, lev, peak;
+
+  fprintf(power_file, "Weighted Switching Activity per Pattern:\n");
+  for (total = 0, peak = 0, p = 0; p < pw->npatterns; p++)
+  {
+    fprintf(power_file, "%d %lld\n", p, pw->pattern_wsa[p]);
+    total += pw->pattern_wsa[p];
+    if (pw->pattern_wsa[p] > pw->pattern_wsa[peak])
+      peak = p;
+  }
+  fprintf(power_file, "\nWeighted Switching Activity per Level:\n");
+  for (lev = 0; lev < pw->nlevels; lev++)
+    fprintf(power_file, "%d %lld\n", lev, pw->level_wsa[lev]);
+  if (pw->npatterns > 0)
+  {
+    fprintf(power_file, "\nPeak = %lld at pattern %d, Average = %.2f\n",
+            pw->pattern_wsa[peak], peak, (double)total / pw->npatterns);
+    printf("Peak switching activity = %lld at pattern %d, average %.2f\n",
+           pw->pattern_wsa[peak], peak, (double)total / pw->npatterns);
+  }
+}
+
+void power_free(power_t *pw)
+{
+  free(pw->weight);
+  free(pw->wclass);
+  free(pw->class_weight);
+  free(pw->narrow);
+  free(pw->count);
+  free(pw->last_zero);
+  free(pw->last_one);
+  free(pw->pattern_wsa);
+  free(pw->level_wsa);
+  free(pw);
+}
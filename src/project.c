@@ -183,7 +183,8 @@ fault_list_t *undetected_flist;
     /* assign primary input values for pattern */
     for (i = 0; i < ckt->npi; i++)
     {
-      ckt->gate[ckt->pi[i]].out_val = pat->in[p][i];
+      if (ckt->pi[i] >= 0)
+        ckt->gate[ckt->pi[i]].out_val = pat->in[p][i];
     }
     /* evaluate all gates */
     for (i = 0; i < ckt->ngates; i++)
@@ -560,6 +561,7 @@ fault_list_t *undetected_flist;
     }
     if (detected_flag)
     {
+      fptr->detect_index = p;
       /* remove fault from undetected fault list */
       if (prev_fptr == (fault_list_t *)NULL)
       {
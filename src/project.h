@@ -63,9 +63,36 @@ struct fault_list_struct
   int input_index;    /* (== -1) if fault at gate output */
                       /* (>= 0)  points to gate input where the fault is */
   stuck_val_t type;   /* type of stuck-at fault */
+  int detect_index;   /* first detecting pattern, -1 if none (yet) */
   fault_list_t *next; /* next fault in list (NULL ptr if end of list) */
 };
 
+typedef struct multi_fault_struct multi_fault_t; /* linked list of tuples */
+struct multi_fault_struct
+{
+  int nfaults;          /* number of stuck-at faults present together */
+  fault_list_t **fault; /* the member faults */
+  multi_fault_t *next;  /* next tuple in list (NULL ptr if end of list) */
+};
+
+typedef enum bridge_type_enum bridge_type_t;
+enum bridge_type_enum
+{
+  WIRED_AND,
+  WIRED_OR,
+  DOMINANT
+};
+
+typedef struct bridge_list_struct bridge_list_t; /* linked list of bridges */
+struct bridge_list_struct
+{
+  int gate_a;          /* index of gate driving the first net */
+  int gate_b;          /* index of gate driving the second net */
+                       /* (DOMINANT: net a overrides net b) */
+  bridge_type_t type;  /* type of bridging fault */
+  bridge_list_t *next; /* next bridge in list (NULL ptr if end of list) */
+};
+
 typedef struct gate_struct gate_t;
 struct gate_struct
 {
@@ -90,5 +117,9 @@ struct circuit_struct
   int npo;      /* number of primary outputs */
   int *pi;      /* array of indices of PI gates */
   int *po;      /* array of indices of PO gates */
+  int nlatch;   /* number of latches (full-scan) */
+  int *ppi;     /* index of the pseudo PI gate of each latch, -1 if unused */
+  int *ppo;     /* index of the pseudo PO gate of each latch */
+  char *po_mask; /* po_mask[j] TRUE if po[j] is not observed, NULL if all are */
   gate_t *gate; /* array of gates */
 };
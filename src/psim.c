@@ -0,0 +1,711 @@
+#include "project.h"
+#include "psim.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <assert.h>
+
+/* Macro Definitions */
+
+/* two-rail gate evaluation from fanin values z0/o0 and z1/o1 into z/o */
+#define compute_gate(type, z, o, z0, o0, z1, o1) \
+  {                                              \
+    switch (type)                                \
+    {                                            \
+    case PO:                                     \
+    case BUF:                                    \
+      z = z0;                                    \
+      o = o0;                                    \
+      break;                                     \
+    case INV:                                    \
+      z = o0;                                    \
+      o = z0;                                    \
+      break;                                     \
+    case AND:                                    \
+      z = z0 | z1;                               \
+      o = o0 & o1;                               \
+      break;                                     \
+    case NAND:                                   \
+      z = o0 & o1;                               \
+      o = z0 | z1;                               \
+      break;                                     \
+    case OR:                                     \
+      z = z0 & z1;                               \
+      o = o0 | o1;                               \
+      break;                                     \
+    case NOR:                                    \
+      z = o0 | o1;                               \
+      o = z0 & z1;                               \
+      break;                                     \
+    case PO_GND:                                 \
+      z = ALL_ONES;                              \
+      o = 0;                                     \
+      break;                                     \
+    case PO_VCC:                                 \
+      z = 0;                                     \
+      o = ALL_ONES;                              \
+      break;                                     \
+    default:                                     \
+      assert(0);                                 \
+    }                                            \
+  }
+
+/*************************************************************************
+
+Function:  psim_create
+
+Purpose:  Allocates the simulation state for a circuit.  Gate levels are
+computed from the (already topologically ordered) gate array and used to
+size the event queue.  ckt->pi[] and ckt->po[] must be set up.  Gates
+that reach only the outputs masked by ckt->po_mask are not observed.
+
+Return:  The new simulator.
+
+*************************************************************************/
+
+psim_t *psim_create(circuit_t *ckt)
+{
+  psim_t *ps;
+  int i, j, lev;
+  int n = ckt->ngates;
+
+  ps = (psim_t *)calloc(1, sizeof(psim_t));
+  ps->ckt = ckt;
+  ps->level = (int *)malloc(n * sizeof(int));
+  ps->po_pos = (int *)malloc(n * sizeof(int));
+  ps->observe = (char *)malloc(n * sizeof(char));
+  ps->zero = (word_t *)calloc(n, sizeof(word_t));
+  ps->one = (word_t *)calloc(n, sizeof(word_t));
+  ps->fzero = (word_t *)calloc(n, sizeof(word_t));
+  ps->fone = (word_t *)calloc(n, sizeof(word_t));
+  ps->stamp = (int *)calloc(n, sizeof(int));
+  ps->qstamp = (int *)calloc(n, sizeof(int));
+  ps->istamp = (int *)calloc(n, sizeof(int));
+  ps->ihead = (int *)malloc(n * sizeof(int));
+  ps->bucket = (int *)malloc(n * sizeof(int));
+  ps->events = (int *)malloc(n * sizeof(int));
+
+  /* levelize */
+  ps->nlevels = 0;
+  for (i = 0; i < n; i++)
+  {
+    lev = 0;
+    for (j = 0; j < MAX_GATE_FANIN; j++)
+    {
+      if (ckt->gate[i].fanin[j] < 0)
+        break;
+      switch (ckt->gate[i].type)
+      {
+      case PI:
+      case PO_GND:
+      case PO_VCC:
+        break;
+      default:
+        assert(ckt->gate[i].fanin[j] < i);
+        if (ps->level[ckt->gate[i].fanin[j]] + 1 > lev)
+          lev = ps->level[ckt->gate[i].fanin[j]] + 1;
+      }
+    }
+    ps->level[i] = lev;
+    if (lev + 1 > ps->nlevels)
+      ps->nlevels = lev + 1;
+    ps->po_pos[i] = -1;
+    ps->observe[i] = TRUE;
+  }
+  for (i = 0; i < ckt->npo; i++)
+    ps->po_pos[ckt->po[i]] = i;
+  if (ckt->po_mask != NULL)
+  {
+    memset(ps->observe, FALSE, n);
+    for (i = 0; i < ckt->npo; i++)
+    {
+      if (!ckt->po_mask[i])
+        psim_observe_cone(ps, ckt->po[i]);
+    }
+  }
+
+  /* one bucket per level, large enough to hold every gate of that level */
+  ps->bucket_start = (int *)calloc(ps->nlevels + 1, sizeof(int));
+  ps->bucket_len = (int *)calloc(ps->nlevels, sizeof(int));
+  for (i = 0; i < n; i++)
+    ps->bucket_start[ps->level[i] + 1]++;
+  for (lev = 0; lev < ps->nlevels; lev++)
+    ps->bucket_start[lev + 1] += ps->bucket_start[lev];
+
+  ps->valid = 0;
+  ps->now = 0;
+  return (ps);
+}
+
+void psim_free(psim_t *ps)
+{
+  if (!ps->clone)
+  {
+    free(ps->level);
+    free(ps->po_pos);
+    free(ps->observe);
+    free(ps->zero);
+    free(ps->one);
+    free(ps->bucket_start);
+  }
+  free(ps->fzero);
+  free(ps->fone);
+  free(ps->stamp);
+  free(ps->qstamp);
+  free(ps->istamp);
+  free(ps->ihead);
+  free(ps->inext);
+  free(ps->bucket);
+  free(ps->bucket_len);
+  free(ps->events);
+  free(ps);
+}
+
+/*************************************************************************
+
+Function:  psim_clone
+
+Purpose:  Allocates a simulator that shares the levels, the observed cone
+and the good machine values of ps, and has faulty machine state of its
+own.  Several threads can then propagate faults against one good machine
+at once, provided ps is not changed meanwhile.  The clone reads ps's good
+values but not ps->valid, which the caller copies.  Free the clone with
+psim_free() before ps.
+
+Return:  The clone.
+
+*************************************************************************/
+
+psim_t *psim_clone(psim_t *ps)
+{
+  psim_t *cl;
+  int n = ps->ckt->ngates;
+
+  cl = (psim_t *)calloc(1, sizeof(psim_t));
+  cl->ckt = ps->ckt;
+  cl->nlevels = ps->nlevels;
+  cl->level = ps->level;
+  cl->po_pos = ps->po_pos;
+  cl->observe = ps->observe;
+  cl->zero = ps->zero;
+  cl->one = ps->one;
+  cl->bucket_start = ps->bucket_start;
+  cl->fzero = (word_t *)calloc(n, sizeof(word_t));
+  cl->fone = (word_t *)calloc(n, sizeof(word_t));
+  cl->stamp = (int *)calloc(n, sizeof(int));
+  cl->qstamp = (int *)calloc(n, sizeof(int));
+  cl->istamp = (int *)calloc(n, sizeof(int));
+  cl->ihead = (int *)malloc(n * sizeof(int));
+  cl->bucket = (int *)malloc(n * sizeof(int));
+  cl->events = (int *)malloc(n * sizeof(int));
+  cl->bucket_len = (int *)calloc(ps->nlevels, sizeof(int));
+  cl->valid = ps->valid;
+  cl->clone = TRUE;
+  return (cl);
+}
+
+/* mark gate i and its fanin cone observed; stops at gates already marked */
+void psim_observe_cone(psim_t *ps, int i)
+{
+  circuit_t *ckt = ps->ckt;
+  gate_t *g;
+  int *stack, n, j, k;
+
+  if (ps->observe[i])
+    return;
+  stack = (int *)malloc(ckt->ngates * sizeof(int));
+  ps->observe[i] = TRUE;
+  stack[0] = i;
+  n = 1;
+  while (n > 0)
+  {
+    g = &ckt->gate[stack[--n]];
+    if (g->type == PI || g->type == PO_GND || g->type == PO_VCC)
+      continue;
+    for (j = 0; j < MAX_GATE_FANIN; j++)
+    {
+      k = g->fanin[j];
+      if (k >= 0 && !ps->observe[k])
+      {
+        ps->observe[k] = TRUE;
+        stack[n++] = k;
+      }
+    }
+  }
+  free(stack);
+}
+
+/*************************************************************************
+
+Function:  psim_load_patterns
+
+Purpose:  Packs up to WORD_BITS patterns starting at pat->in[first] into
+the primary input words, one pattern per lane.
+
+Return:  Number of patterns loaded.
+
+*************************************************************************/
+
+int psim_load_patterns(psim_t *ps, pattern_t *pat, int first)
+{
+  circuit_t *ckt = ps->ckt;
+  int i, p, n;
+  int *row;
+
+  n = pat->len - first;
+  if (n > WORD_BITS)
+    n = WORD_BITS;
+  for (i = 0; i < ckt->npi; i++)
+  {
+    if (ckt->pi[i] < 0)
+      continue;
+    ps->zero[ckt->pi[i]] = 0;
+    ps->one[ckt->pi[i]] = 0;
+  }
+  for (p = 0; p < n; p++)
+  {
+    row = pat->in[first + p];
+    for (i = 0; i < ckt->npi; i++)
+    {
+      if (ckt->pi[i] < 0)
+        continue;
+      if (row[i] == LOGIC_0)
+        ps->zero[ckt->pi[i]] |= LANE(p);
+      else if (row[i] == LOGIC_1)
+        ps->one[ckt->pi[i]] |= LANE(p);
+    }
+  }
+  ps->valid = (n == WORD_BITS) ? ALL_ONES : LANE(n) - 1;
+  return (n);
+}
+
+/*************************************************************************
+
+Function:  psim_good_eval
+
+Purpose:  Evaluates the fault-free circuit for all lanes from the values
+already placed on the primary inputs.  Unobserved gates are set to X.
+
+*************************************************************************/
+
+void psim_good_eval(psim_t *ps)
+{
+  circuit_t *ckt = ps->ckt;
+  gate_t *g;
+  int i;
+
+  for (i = 0; i < ckt->ngates; i++)
+  {
+    g = &ckt->gate[i];
+    if (!ps->observe[i] && g->type != PI)
+    {
+      ps->zero[i] = ps->one[i] = 0;
+      continue;
+    }
+    switch (g->type)
+    {
+    case PI:
+      break;
+    case PO_GND:
+    case PO_VCC:
+      compute_gate(g->type, ps->zero[i], ps->one[i], 0, 0, 0, 0);
+      break;
+    case PO:
+    case BUF:
+    case INV:
+      compute_gate(g->type, ps->zero[i], ps->one[i],
+                   ps->zero[g->fanin[0]], ps->one[g->fanin[0]], 0, 0);
+      break;
+    default:
+      compute_gate(g->type, ps->zero[i], ps->one[i],
+                   ps->zero[g->fanin[0]], ps->one[g->fanin[0]],
+                   ps->zero[g->fanin[1]], ps->one[g->fanin[1]]);
+    }
+  }
+}
+
+/* copy the good primary output values of the current block into pat->out */
+void psim_store_outputs(psim_t *ps, pattern_t *pat, int first)
+{
+  circuit_t *ckt = ps->ckt;
+  int j, p, g;
+
+  for (p = 0; p < WORD_BITS && (ps->valid & LANE(p)); p++)
+  {
+    for (j = 0; j < ckt->npo; j++)
+    {
+      g = ckt->po[j];
+      if (ps->one[g] & LANE(p))
+        pat->out[first + p][j] = LOGIC_1;
+      else if (ps->zero[g] & LANE(p))
+        pat->out[first + p][j] = LOGIC_0;
+      else
+        pat->out[first + p][j] = LOGIC_X;
+    }
+  }
+}
+
+/*************************************************************************
+
+Function:  psim_broadcast
+
+Purpose:  Copies the good values of one pattern (lane "lane" of src) into
+every lane of dst, so that the lanes of dst can carry different faulty
+machines for the same pattern (parallel-fault simulation).
+
+*************************************************************************/
+
+void psim_broadcast(psim_t *dst, psim_t *src, int lane)
+{
+  int i;
+
+  for (i = 0; i < src->ckt->ngates; i++)
+  {
+    dst->zero[i] = -((src->zero[i] >> lane) & 1);
+    dst->one[i] = -((src->one[i] >> lane) & 1);
+  }
+  dst->valid = ALL_ONES;
+}
+
+/* restart the stamps before the counter wraps */
+static void psim_new_run(psim_t *ps)
+{
+  if (ps->now == INT_MAX)
+  {
+    memset(ps->stamp, 0, ps->ckt->ngates * sizeof(int));
+    memset(ps->qstamp, 0, ps->ckt->ngates * sizeof(int));
+    memset(ps->istamp, 0, ps->ckt->ngates * sizeof(int));
+    ps->now = 0;
+  }
+  ps->now++;
+}
+
+#define schedule(ps, i)                                                       \
+  {                                                                           \
+    if ((ps)->qstamp[i] != (ps)->now)                                         \
+    {                                                                         \
+      (ps)->qstamp[i] = (ps)->now;                                            \
+      (ps)->bucket[(ps)->bucket_start[(ps)->level[i]] +                       \
+                   (ps)->bucket_len[(ps)->level[i]]++] = (i);                 \
+      if ((ps)->level[i] < lo)                                                \
+        lo = (ps)->level[i];                                                  \
+      if ((ps)->level[i] > hi)                                                \
+        hi = (ps)->level[i];                                                  \
+    }                                                                         \
+  }
+
+/*************************************************************************
+
+Function:  psim_propagate
+
+Purpose:  Simulates one faulty machine per lane against the good values
+of the current block.  The faulty machine is the good circuit with the
+values in inj[0..ninj-1] forced; only gates whose value differs from the
+good machine are evaluated.  Injections may sit on any number of gates,
+so the same routine serves single stuck-at faults, bridges and multiple
+faults.  The gates whose value differs are listed in ps->events[].
+
+Return:  Lanes in which some observed primary output is 0 in one machine
+and 1 in the other.
+
+*************************************************************************/
+
+word_t psim_propagate(psim_t *ps, inject_t *inj, int ninj)
+{
+  circuit_t *ckt = ps->ckt;
+  gate_t *g;
+  int i, j, k, lev, lo, hi;
+  word_t z[MAX_GATE_FANIN], o[MAX_GATE_FANIN];
+  word_t rz, ro, detect;
+  int now;
+
+  psim_new_run(ps);
+  now = ps->now;
+  lo = ps->nlevels;
+  hi = -1;
+  ps->nevents = 0;
+  if (ninj > ps->inext_size)
+  {
+    ps->inext_size = ninj;
+    ps->inext = (int *)realloc(ps->inext, ninj * sizeof(int));
+  }
+  for (k = 0; k < ninj; k++)
+  {
+    i = inj[k].gate_index;
+    if (ps->istamp[i] != now)
+    {
+      ps->istamp[i] = now;
+      ps->ihead[i] = -1;
+    }
+    ps->inext[k] = ps->ihead[i];
+    ps->ihead[i] = k;
+    schedule(ps, i);
+  }
+
+  detect = 0;
+  for (lev = lo; lev <= hi; lev++)
+  {
+    for (k = 0; k < ps->bucket_len[lev]; k++)
+    {
+      i = ps->bucket[ps->bucket_start[lev] + k];
+      g = &ckt->gate[i];
+      if (!ps->observe[i])
+        continue;
+
+      /* fetch input values, faulty where the fanin has been disturbed */
+      for (j = 0; j < MAX_GATE_FANIN; j++)
+      {
+        if ((g->type == PI) || (g->type == PO_GND) || (g->type == PO_VCC) ||
+            (g->fanin[j] < 0))
+        {
+          z[j] = o[j] = 0;
+        }
+        else if (ps->stamp[g->fanin[j]] == now)
+        {
+          z[j] = ps->fzero[g->fanin[j]];
+          o[j] = ps->fone[g->fanin[j]];
+        }
+        else
+        {
+          z[j] = ps->zero[g->fanin[j]];
+          o[j] = ps->one[g->fanin[j]];
+        }
+      }
+
+      /* force injected input values */
+      if (ps->istamp[i] == now)
+      {
+        for (j = ps->ihead[i]; j >= 0; j = ps->inext[j])
+        {
+          if (inj[j].input_index >= 0)
+          {
+            z[inj[j].input_index] = (z[inj[j].input_index] & ~inj[j].lanes) |
+                                    (inj[j].zero & inj[j].lanes);
+            o[inj[j].input_index] = (o[inj[j].input_index] & ~inj[j].lanes) |
+                                    (inj[j].one & inj[j].lanes);
+          }
+        }
+      }
+
+      if (g->type == PI)
+      {
+        rz = ps->zero[i];
+        ro = ps->one[i];
+      }
+      else
+        compute_gate(g->type, rz, ro, z[0], o[0], z[1], o[1]);
+
+      /* force injected output values */
+      if (ps->istamp[i] == now)
+      {
+        for (j = ps->ihead[i]; j >= 0; j = ps->inext[j])
+        {
+          if (inj[j].input_index < 0)
+          {
+            rz = (rz & ~inj[j].lanes) | (inj[j].zero & inj[j].lanes);
+            ro = (ro & ~inj[j].lanes) | (inj[j].one & inj[j].lanes);
+          }
+        }
+      }
+
+      /* fault effect dies out here */
+      if ((((rz ^ ps->zero[i]) | (ro ^ ps->one[i])) & ps->valid) == 0)
+        continue;
+
+      ps->fzero[i] = rz;
+      ps->fone[i] = ro;
+      ps->stamp[i] = now;
+      ps->events[ps->nevents++] = i;
+      if (ps->po_pos[i] >= 0)
+        detect |= ((ps->one[i] & rz) | (ps->zero[i] & ro)) & ps->valid;
+      for (j = 0; j < g->num_fanout; j++)
+        schedule(ps, g->fanout[j]);
+    }
+    ps->bucket_len[lev] = 0;
+  }
+  return (detect);
+}
+
+/*************************************************************************
+
+Function:  psim_good_update
+
+Purpose:  Re-evaluates the good machine after the caller has changed the
+values of the primary inputs gates[0..n-1], visiting only the gates whose
+value changes.  Faulty values of earlier propagations become invalid.
+
+*************************************************************************/
+
+void psim_good_update(psim_t *ps, int *gates, int n)
+{
+  circuit_t *ckt = ps->ckt;
+  gate_t *g;
+  int i, j, k, lev, lo, hi;
+  word_t z0, o0, z1, o1, rz, ro;
+
+  psim_new_run(ps);
+  lo = ps->nlevels;
+  hi = -1;
+  for (k = 0; k < n; k++)
+  {
+    g = &ckt->gate[gates[k]];
+    for (j = 0; j < g->num_fanout; j++)
+      schedule(ps, g->fanout[j]);
+  }
+  for (lev = lo; lev <= hi; lev++)
+  {
+    for (k = 0; k < ps->bucket_len[lev]; k++)
+    {
+      i = ps->bucket[ps->bucket_start[lev] + k];
+      g = &ckt->gate[i];
+      if (!ps->observe[i])
+        continue;
+      z0 = o0 = z1 = o1 = 0;
+      switch (g->type)
+      {
+      case PO_GND:
+      case PO_VCC:
+        break;
+      case AND:
+      case NAND:
+      case OR:
+      case NOR:
+        z1 = ps->zero[g->fanin[1]];
+        o1 = ps->one[g->fanin[1]];
+        /* fall through */
+      default:
+        z0 = ps->zero[g->fanin[0]];
+        o0 = ps->one[g->fanin[0]];
+      }
+      compute_gate(g->type, rz, ro, z0, o0, z1, o1);
+      if (rz == ps->zero[i] && ro == ps->one[i])
+        continue;
+      ps->zero[i] = rz;
+      ps->one[i] = ro;
+      for (j = 0; j < g->num_fanout; j++)
+        schedule(ps, g->fanout[j]);
+    }
+    ps->bucket_len[lev] = 0;
+  }
+}
+
+/* describe stuck-at fault *fptr as an injection in every lane */
+void psim_fault_inject(fault_list_t *fptr, inject_t *inj)
+{
+  inj->gate_index = fptr->gate_index;
+  inj->input_index = fptr->input_index;
+  inj->lanes = ALL_ONES;
+  inj->zero = (fptr->type == S_A_0) ? ALL_ONES : 0;
+  inj->one = (fptr->type == S_A_1) ? ALL_ONES : 0;
+}
+
+/* xorshift64* generator; *state must be non-zero */
+word_t psim_random(word_t *state)
+{
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return (*state * 0x2545F4914F6CDD1DULL);
+}
+
+/*************************************************************************
+
+Function:  psim_fault_array
+
+Purpose:  Counts the faults of flist into *nfaults and lists them in an
+array, in list order, so an engine can index them and flag them in a
+parallel array.
+
+Return:  The array, nfaults + 1 entries long; free() it when done.
+
+*************************************************************************/
+
+fault_list_t **psim_fault_array(fault_list_t *flist, int *nfaults)
+{
+  fault_list_t *fptr, **faults;
+
+  LIST_TO_ARRAY(flist, fptr, faults, *nfaults);
+  return (faults);
+}
+
+/*************************************************************************
+
+Function:  psim_unlink_detected
+
+Purpose:  Relinks the faults of an array from psim_fault_array() that are
+not flagged in detected[], keeping their order.  The detected ones are
+left out of the list but not freed.
+
+Return:  List of the faults that remain undetected.
+
+*************************************************************************/
+
+fault_list_t *psim_unlink_detected(fault_list_t **faults, char *detected,
+                                   int nfaults)
+{
+  fault_list_t *flist;
+
+  UNLINK_DETECTED(flist, faults, detected, nfaults);
+  return (flist);
+}
+
+/*************************************************************************
+
+Function:  parallel_fault_simulate
+
+Purpose:  Same contract as three_val_fault_simulate(), but the patterns
+are simulated WORD_BITS at a time (parallel-pattern single-fault
+propagation).  A fault is dropped as soon as it is detected in some block.
+The toggles of the good machine are counted into "power" unless it is
+NULL.
+
+pat.out[][] is filled with the fault-free output patterns corresponding to
+the input patterns in pat.in[][].
+
+Return:  List of faults that remain undetected, in their original order.
+
+*************************************************************************/
+
+fault_list_t *parallel_fault_simulate(circuit_t *ckt, pattern_t *pat,
+                                      fault_list_t *undetected_flist,
+                                      power_t *power)
+{
+  psim_t *ps;
+  fault_list_t **faults;
+  char *detected;
+  inject_t inj;
+  word_t d;
+  int nfaults, f, first;
+
+  faults = psim_fault_array(undetected_flist, &nfaults);
+  detected = (char *)calloc(nfaults + 1, sizeof(char));
+
+  ps = psim_create(ckt);
+  for (first = 0; first < pat->len; first += WORD_BITS)
+  {
+    psim_load_patterns(ps, pat, first);
+    psim_good_eval(ps);
+    psim_store_outputs(ps, pat, first);
+    if (power != NULL)
+      power_block(power, ps);
+    for (f = 0; f < nfaults; f++)
+    {
+      if (detected[f])
+        continue;
+      psim_fault_inject(faults[f], &inj);
+      if ((d = psim_propagate(ps, &inj, 1)) != 0)
+      {
+        detected[f] = TRUE;
+        faults[f]->detect_index = first + lowest_lane(d);
+      }
+    }
+  }
+  psim_free(ps);
+
+  undetected_flist = psim_unlink_detected(faults, detected, nfaults);
+  free(faults);
+  free(detected);
+  return (undetected_flist);
+}
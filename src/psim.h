@@ -0,0 +1,199 @@
+/*
+ * Pattern-parallel 3-valued simulation kernel.
+ *
+ * Every signal is held as a pair of machine words.  Bit p of the "one" word
+ * is set when the signal is LOGIC_1 in lane p, bit p of the "zero" word when
+ * it is LOGIC_0; a lane with neither bit set is LOGIC_X.  A lane is normally
+ * one pattern of a 64-pattern block, so one gate evaluation simulates 64
+ * patterns at once.
+ *
+ * Faulty machines are simulated event-driven: psim_propagate() forces the
+ * values described by a list of injections and re-evaluates only the gates
+ * whose value differs from the good machine, level by level, until the
+ * effect dies out or reaches the primary outputs.
+ */
+
+#ifndef _PSIM_H
+#define _PSIM_H
+
+/* include project.h first */
+
+typedef unsigned long long word_t;
+
+#define WORD_BITS 64
+#define ALL_ONES (~(word_t)0)
+#define LANE(p) ((word_t)1 << (p))
+#define popcount(w) __builtin_popcountll(w)
+#define lowest_lane(w) __builtin_ctzll(w)
+
+/* list helpers for any struct chained through "next".  LIST_TO_ARRAY
+   counts "list" into n and copies it, walked with the cursor "ptr", into
+   a new array "items" of n + 1 entries; free() it when done.
+   UNLINK_DETECTED relinks the entries of items[0..n-1] not flagged in
+   detected[] into "list", keeping their order. */
+#define LIST_TO_ARRAY(list, ptr, items, n)                                    \
+  do                                                                          \
+  {                                                                           \
+    for ((n) = 0, (ptr) = (list); (ptr) != NULL; (ptr) = (ptr)->next)         \
+      (n)++;                                                                  \
+    (items) = malloc(((n) + 1) * sizeof(*(items)));                           \
+    for ((n) = 0, (ptr) = (list); (ptr) != NULL; (ptr) = (ptr)->next)         \
+      (items)[(n)++] = (ptr);                                                 \
+  } while (0)
+#define UNLINK_DETECTED(list, items, detected, n)                             \
+  do                                                                          \
+  {                                                                           \
+    int unlink_i_;                                                            \
+    (list) = NULL;                                                            \
+    for (unlink_i_ = (n) - 1; unlink_i_ >= 0; unlink_i_--)                    \
+    {                                                                         \
+      if (!(detected)[unlink_i_])                                             \
+      {                                                                       \
+        (items)[unlink_i_]->next = (list);                                    \
+        (list) = (items)[unlink_i_];                                          \
+      }                                                                       \
+    }                                                                         \
+  } while (0)
+
+/* a value forced onto a gate output (input_index == -1) or gate input pin
+   in the lanes selected by "lanes" */
+typedef struct inject_struct inject_t;
+struct inject_struct
+{
+  int gate_index;
+  int input_index;
+  word_t lanes;
+  word_t zero; /* forced value, two-rail */
+  word_t one;
+};
+
+typedef struct psim_struct psim_t;
+struct psim_struct
+{
+  circuit_t *ckt;
+  int nlevels;      /* number of logic levels */
+  int *level;       /* logic level of each gate */
+  int *po_pos;      /* position of gate in ckt->po[], -1 if not a PO */
+  char *observe;    /* FALSE if gate reaches no observed PO; such gates are
+                       not simulated and stay X */
+  word_t valid;     /* lanes of the current block holding a pattern */
+  word_t *zero;     /* good machine values of the current block */
+  word_t *one;
+  word_t *fzero;    /* faulty machine values, valid iff stamp == now */
+  word_t *fone;
+  int *stamp;
+  int *qstamp;      /* gate already queued in this propagation */
+  int *istamp;      /* gate carries an injection in this propagation */
+  int *ihead;       /* first injection on the gate, chained through inext */
+  int *inext;
+  int inext_size;
+  int now;
+  int *bucket;      /* event queue, one bucket per level */
+  int *bucket_start;
+  int *bucket_len;
+  int *events;      /* gates stamped by the last propagation */
+  int nevents;
+  int clone;        /* shares the arrays above "fzero" with another psim_t */
+};
+
+/* logic BIST setup and result */
+typedef struct bist_struct bist_t;
+struct bist_struct
+{
+  unsigned long long npatterns; /* number of patterns to apply */
+  word_t lfsr_poly;             /* LFSR polynomial, with its leading term */
+  word_t lfsr_seed;             /* initial LFSR state, non-zero */
+  int phase_taps;               /* LFSR cells XORed into each primary input */
+  word_t misr_poly;             /* MISR polynomial, with its leading term */
+  word_t signature;             /* fault-free MISR contents after the test */
+  unsigned long long nx;        /* X values that reached the MISR */
+};
+
+/* switching activity of the good machine, kept by power_block() */
+typedef struct power_struct power_t;
+struct power_struct
+{
+  int npatterns;          /* patterns counted so far */
+  int nlevels;
+  int *weight;            /* load of each gate, its fanout count or 1 */
+  int *wclass;            /* gates of equal weight share a class */
+  int nclasses;
+  int *class_weight;
+  word_t *narrow;         /* 4-bit toggle count of each class, bit-sliced */
+  int *count;             /* words added to each narrow count */
+  word_t *last_zero;      /* value of each gate in the last pattern counted, */
+  word_t *last_one;       /* in lane 0 */
+  long long *pattern_wsa; /* weighted toggles from the previous pattern */
+  long long *level_wsa;   /* weighted toggles of each level, all patterns */
+};
+
+/* outcome counts of atpg_top_off() */
+typedef struct atpg_stats_struct atpg_stats_t;
+struct atpg_stats_struct
+{
+  int patterns;   /* tests generated */
+  int untestable; /* faults proven redundant */
+  int aborted;    /* faults given up at the backtrack limit */
+};
+
+/* equivalence classes of a fault list, kept by collapse_faults() */
+typedef struct collapse_struct collapse_t;
+struct collapse_struct
+{
+  int nfaults;           /* faults of the uncollapsed list */
+  int nclasses;          /* faults simulated */
+  fault_list_t **faults; /* the uncollapsed list, in order */
+  int *rep;              /* position of the first fault of each class */
+  int nderived;          /* dominance relations, in gate order: */
+  int *derived;          /* class detected when one of */
+  int *dominated;        /* MAX_GATE_FANIN classes (-1 if unused) is */
+  int ndropped;          /* classes left out by dominance */
+};
+
+/* PODEM outcomes */
+#define ATPG_DETECTED 0
+#define ATPG_UNTESTABLE 1
+#define ATPG_ABORTED 2
+
+/* fault orders of ordered_fault_simulate() */
+#define ORDER_SCOAP 1
+#define ORDER_LEVEL 2
+
+/* fault collapsing modes */
+#define COLLAPSE_NONE 0
+#define COLLAPSE_EQUIV 1
+#define COLLAPSE_DOM 2
+
+/* kernel, defined in psim.c */
+extern psim_t *psim_create(circuit_t *ckt);
+extern void psim_free(psim_t *ps);
+extern psim_t *psim_clone(psim_t *ps);
+extern int psim_load_patterns(psim_t *ps, pattern_t *pat, int first);
+extern void psim_good_eval(psim_t *ps);
+extern void psim_store_outputs(psim_t *ps, pattern_t *pat, int first);
+extern void psim_broadcast(psim_t *dst, psim_t *src, int lane);
+extern word_t psim_propagate(psim_t *ps, inject_t *inj, int ninj);
+extern void psim_good_update(psim_t *ps, int *gates, int n);
+extern void psim_observe_cone(psim_t *ps, int i);
+extern void psim_fault_inject(fault_list_t *fptr, inject_t *inj);
+extern word_t psim_random(word_t *state);
+extern fault_list_t **psim_fault_array(fault_list_t *flist, int *nfaults);
+extern fault_list_t *psim_unlink_detected(fault_list_t **faults, char *detected,
+                                          int nfaults);
+
+/* engines */
+extern fault_list_t *parallel_fault_simulate(circuit_t *ckt, pattern_t *pat,
+                                             fault_list_t *undetected_flist,
+                                             power_t *power);
+
+/* switching activity, defined in power.c */
+extern void power_block(power_t *pw, psim_t *ps);
+
+/* SCOAP measures, defined in scoap.c */
+extern void scoap_measures(circuit_t *ckt, int *cc0, int *cc1, int *co);
+extern int scoap_input_co(circuit_t *ckt, int *cc0, int *cc1, int *co, int i,
+                          int k);
+extern int scoap_fault_cost(circuit_t *ckt, int *cc0, int *cc1, int *co,
+                            fault_list_t *fptr);
+
+#endif
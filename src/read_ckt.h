@@ -51,7 +51,11 @@ struct Gate_Info{
 
 /* use following functions to build circuit */
 extern void Add_Gate(const Gate_Info_t *);
+extern void Add_Latch(char *in, char *out);
 extern void Build_Ckt();
+/* index of the gate driving net "name" (or of the PO gate of that name if
+   "po" is TRUE), -1 if there is none */
+extern int Find_Gate(const char *name, int po);
 
 /*Global variable(s) */ 
 extern circuit_t ckt;   /* Whole simulation will rely on this variable:-) */
@@ -0,0 +1,234 @@
+#include "project.h"
+#include "psim.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*
+ * Static redundancy identification.
+ *
+ * Lane 0 of a psim_t is simulated with every primary input X, so the only
+ * binary values are those implied by the constant gates.  A stuck-at fault
+ * whose line is implied to its stuck value cannot be excited, and a fault
+ * with no path of X lines to an observed primary output cannot be
+ * observed: its effect is masked by implied values whatever the inputs.
+ *
+ * Reconvergent redundancy is found FIRE-style on each fanout stem s: the
+ * faults untestable when s is implied to 0 and untestable when s is
+ * implied to 1 need a value of s that no pattern gives, so they are
+ * redundant.  Implications are forward only.  A value implied while the
+ * fault line is X holds whatever value the fault forces there, so the
+ * masking argument carries over to the faulty machine, provided the fault
+ * cannot disturb s itself, i.e. its line is outside the fanin cone of s.
+ */
+
+#define val(ps, i)                                                            \
+  (((ps)->one[i] & 1) ? LOGIC_1 : ((ps)->zero[i] & 1) ? LOGIC_0 : LOGIC_X)
+
+/* line whose value the fault forces */
+#define fault_line(ckt, fptr)                                                 \
+  (((fptr)->input_index < 0)                                                  \
+       ? (fptr)->gate_index                                                   \
+       : (ckt)->gate[(fptr)->gate_index].fanin[(fptr)->input_index])
+
+/* fill xreach[]: the gate is X and is an observed PO or drives a gate with
+   an X path; return the number of gates whose flag differs from ref[] (all
+   of them when ref is NULL) and list them in touched[] */
+static int mark_xreach(psim_t *ps, char *xreach, char *ref, int *touched)
+{
+  circuit_t *ckt = ps->ckt;
+  gate_t *g;
+  int i, j, n;
+
+  n = 0;
+  for (i = ckt->ngates - 1; i >= 0; i--)
+  {
+    g = &ckt->gate[i];
+    xreach[i] = FALSE;
+    if (val(ps, i) == LOGIC_X)
+    {
+      if (ps->po_pos[i] >= 0 && ps->observe[i])
+        xreach[i] = TRUE;
+      for (j = 0; j < g->num_fanout && !xreach[i]; j++)
+        xreach[i] = xreach[g->fanout[j]];
+    }
+    if (ref != NULL && xreach[i] != ref[i])
+      touched[n++] = i;
+  }
+  return (n);
+}
+
+/* TRUE if the implied values make fault *fptr untestable; faults on lines
+   marked in cone[] (value "mark") may only be refuted by excitation */
+static int untestable(psim_t *ps, char *xreach, fault_list_t *fptr,
+                      int *cone, int mark)
+{
+  int line = fault_line(ps->ckt, fptr);
+  int v = val(ps, line);
+
+  if (v == ((fptr->type == S_A_0) ? LOGIC_0 : LOGIC_1))
+    return (TRUE);
+  if (v != LOGIC_X || (cone != NULL && cone[line] == mark))
+    return (FALSE);
+  return (!xreach[fptr->gate_index]);
+}
+
+/* mark the fanin cone of gate s, s included, with "mark" */
+static void mark_fanin_cone(circuit_t *ckt, int s, int *cone, int mark,
+                            int *stack)
+{
+  gate_t *g;
+  int n, i, k;
+
+  cone[s] = mark;
+  stack[0] = s;
+  n = 1;
+  while (n > 0)
+  {
+    g = &ckt->gate[stack[--n]];
+    if (g->type == PI || g->type == PO_GND || g->type == PO_VCC)
+      continue;
+    for (k = 0; k < MAX_GATE_FANIN; k++)
+    {
+      i = g->fanin[k];
+      if (i >= 0 && cone[i] != mark)
+      {
+        cone[i] = mark;
+        stack[n++] = i;
+      }
+    }
+  }
+}
+
+/*************************************************************************
+
+Function:  identify_redundant
+
+Purpose:  Proves faults of flist redundant from the netlist alone (see
+above), without patterns.  The redundant faults are unlinked from flist
+and returned through *redundant, both lists keeping the original order.
+
+Return:  List of faults left for simulation.
+
+*************************************************************************/
+
+fault_list_t *identify_redundant(circuit_t *ckt, fault_list_t *flist,
+                                 fault_list_t **redundant)
+{
+  psim_t *ps;
+  fault_list_t **faults, *keep;
+  gate_t *g;
+  char *xreach, *xreach0, *val0, *red;
+  int *first, *next, *touched, *cone, *stack, *seen;
+  int nfaults, ntouched, f, i, j, k, s, v, t, stem;
+
+  faults = psim_fault_array(flist, &nfaults);
+  red = (char *)calloc(nfaults + 1, sizeof(char));
+  seen = (int *)calloc(nfaults + 1, sizeof(int));
+  next = (int *)malloc((nfaults + 1) * sizeof(int));
+  first = (int *)malloc(ckt->ngates * sizeof(int));
+  for (i = 0; i < ckt->ngates; i++)
+    first[i] = -1;
+  /* faults chained per gate, reverse list order */
+  for (f = 0; f < nfaults; f++)
+  {
+    next[f] = first[faults[f]->gate_index];
+    first[faults[f]->gate_index] = f;
+  }
+  xreach = (char *)malloc(ckt->ngates);
+  xreach0 = (char *)malloc(ckt->ngates);
+  val0 = (char *)malloc(ckt->ngates);
+  touched = (int *)malloc(2 * ckt->ngates * sizeof(int));
+  cone = (int *)calloc(ckt->ngates, sizeof(int));
+  stack = (int *)malloc(ckt->ngates * sizeof(int));
+
+  /* constants alone */
+  ps = psim_create(ckt);
+  ps->valid = LANE(0);
+  for (i = 0; i < ckt->npi; i++)
+  {
+    if (ckt->pi[i] >= 0)
+      ps->zero[ckt->pi[i]] = ps->one[ckt->pi[i]] = 0;
+  }
+  psim_good_eval(ps);
+  for (i = 0; i < ckt->ngates; i++)
+    val0[i] = val(ps, i);
+  mark_xreach(ps, xreach0, NULL, NULL);
+  for (f = 0; f < nfaults; f++)
+    red[f] = untestable(ps, xreach0, faults[f], NULL, 0);
+
+  /* both values of each fanout stem */
+  for (s = 0, stem = 0; s < ckt->ngates; s++)
+  {
+    g = &ckt->gate[s];
+    if (g->num_fanout < 2 || val(ps, s) != LOGIC_X)
+      continue;
+    stem++;
+    mark_fanin_cone(ckt, s, cone, stem, stack);
+    for (v = 0; v < 2; v++)
+    {
+      ps->zero[s] = (v == 0) ? ALL_ONES : 0;
+      ps->one[s] = (v == 1) ? ALL_ONES : 0;
+      psim_good_update(ps, &s, 1);
+
+      /* faults whose verdict can differ from the constants-only pass sit
+         on or drive a gate whose value or X path changed */
+      ntouched = mark_xreach(ps, xreach, xreach0, touched);
+      for (i = s; i < ckt->ngates; i++)
+      {
+        if (val(ps, i) != val0[i])
+          touched[ntouched++] = i;
+      }
+      for (t = 0; t < ntouched; t++)
+      {
+        i = touched[t];
+        /* faults on gate i, then faults on input pins driven by i */
+        for (j = -1; j < ckt->gate[i].num_fanout; j++)
+        {
+          k = (j < 0) ? i : ckt->gate[i].fanout[j];
+          for (f = first[k]; f >= 0; f = next[f])
+          {
+            if (red[f] || (j >= 0 && fault_line(ckt, faults[f]) != i))
+              continue;
+            if (v == 0)
+            {
+              if (untestable(ps, xreach, faults[f], cone, stem))
+                seen[f] = stem;
+            }
+            else if (seen[f] == stem &&
+                     untestable(ps, xreach, faults[f], cone, stem))
+            {
+              red[f] = TRUE;
+              seen[f] = 0;
+            }
+          }
+        }
+      }
+      ps->zero[s] = ps->one[s] = 0;
+      psim_good_update(ps, &s, 1);
+    }
+  }
+  psim_free(ps);
+
+  /* split the list, keeping the order: the redundant faults are those
+     left out of keep, and the only ones kept once red[] is flipped */
+  keep = psim_unlink_detected(faults, red, nfaults);
+  for (f = 0; f < nfaults; f++)
+    red[f] = !red[f];
+  *redundant = psim_unlink_detected(faults, red, nfaults);
+
+  free(faults);
+  free(red);
+  free(seen);
+  free(next);
+  free(first);
+  free(xreach);
+  free(xreach0);
+  free(val0);
+  free(touched);
+  free(cone);
+  free(stack);
+  return (keep);
+}
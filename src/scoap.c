@@ -0,0 +1,411 @@
+#include "project.h"
+#include "psim.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <assert.h>
+
+/*
+ * SCOAP testability measures and testability-guided fault simulation.
+ *
+ * cc0[g] / cc1[g] count the primary input assignments needed to set gate g
+ * to 0 / 1 and co[g] the assignments needed to observe it at a primary
+ * output.  The cost of a stuck-at fault is the controllability of the
+ * opposite value at its line plus the observability of that line; faults
+ * with a low cost are the easy ones random patterns catch early.
+ */
+
+#define SCOAP_INF (INT_MAX / 4)      /* value cannot be set / observed */
+#define YIELD_SAMPLE 16              /* hard faults that rank the blocks */
+#define ORDER_CACHE_BYTES (64 << 20) /* good values kept for the 2nd pass */
+
+/* saturating sums of measures */
+static int cost2(int a, int b)
+{
+  return ((a >= SCOAP_INF || b >= SCOAP_INF) ? SCOAP_INF : a + b);
+}
+
+static int min2(int a, int b)
+{
+  return ((a < b) ? a : b);
+}
+
+/*************************************************************************
+
+Function:  scoap_measures
+
+Purpose:  Fills cc0[], cc1[] in gate order and co[] in reverse gate
+order.  The observed primary outputs have co 0; a fanout stem takes the
+cheapest of its branches.
+
+*************************************************************************/
+
+void scoap_measures(circuit_t *ckt, int *cc0, int *cc1, int *co)
+{
+  gate_t *g, *h;
+  int i, j, k, a0, a1, b0, b1, c;
+
+  for (i = 0; i < ckt->ngates; i++)
+  {
+    g = &ckt->gate[i];
+    a0 = a1 = b0 = b1 = SCOAP_INF;
+    if (g->type != PI && g->fanin[0] >= 0)
+    {
+      a0 = cc0[g->fanin[0]];
+      a1 = cc1[g->fanin[0]];
+    }
+    if (g->type != PI && g->fanin[1] >= 0)
+    {
+      b0 = cc0[g->fanin[1]];
+      b1 = cc1[g->fanin[1]];
+    }
+    switch (g->type)
+    {
+    case PI:
+      cc0[i] = cc1[i] = 1;
+      break;
+    case AND:
+      cc0[i] = cost2(min2(a0, b0), 1);
+      cc1[i] = cost2(cost2(a1, b1), 1);
+      break;
+    case NAND:
+      cc0[i] = cost2(cost2(a1, b1), 1);
+      cc1[i] = cost2(min2(a0, b0), 1);
+      break;
+    case OR:
+      cc0[i] = cost2(cost2(a0, b0), 1);
+      cc1[i] = cost2(min2(a1, b1), 1);
+      break;
+    case NOR:
+      cc0[i] = cost2(min2(a1, b1), 1);
+      cc1[i] = cost2(cost2(a0, b0), 1);
+      break;
+    case INV:
+      cc0[i] = cost2(a1, 1);
+      cc1[i] = cost2(a0, 1);
+      break;
+    case BUF:
+      cc0[i] = cost2(a0, 1);
+      cc1[i] = cost2(a1, 1);
+      break;
+    case PO:
+      cc0[i] = a0;
+      cc1[i] = a1;
+      break;
+    case PO_GND:
+      cc0[i] = 0;
+      cc1[i] = SCOAP_INF;
+      break;
+    case PO_VCC:
+      cc0[i] = SCOAP_INF;
+      cc1[i] = 0;
+      break;
+    default:
+      assert(0);
+    }
+  }
+
+  for (i = 0; i < ckt->ngates; i++)
+    co[i] = SCOAP_INF;
+  for (i = 0; i < ckt->npo; i++)
+  {
+    if (ckt->po_mask == NULL || !ckt->po_mask[i])
+      co[ckt->po[i]] = 0;
+  }
+  for (i = ckt->ngates - 1; i >= 0; i--)
+  {
+    g = &ckt->gate[i];
+    if (g->type == PO)
+      continue;
+    for (j = 0; j < g->num_fanout; j++)
+    {
+      h = &ckt->gate[g->fanout[j]];
+      for (k = 0; k < MAX_GATE_FANIN; k++)
+      {
+        if (h->fanin[k] != i)
+          continue;
+        c = scoap_input_co(ckt, cc0, cc1, co, g->fanout[j], k);
+        if (c < co[i])
+          co[i] = c;
+      }
+    }
+  }
+}
+
+/* observability of input k of gate i: its output plus the cost of making
+   the other input non-controlling */
+int scoap_input_co(circuit_t *ckt, int *cc0, int *cc1, int *co, int i, int k)
+{
+  gate_t *g = &ckt->gate[i];
+
+  switch (g->type)
+  {
+  case AND:
+  case NAND:
+    return (cost2(cost2(co[i], cc1[g->fanin[1 - k]]), 1));
+  case OR:
+  case NOR:
+    return (cost2(cost2(co[i], cc0[g->fanin[1 - k]]), 1));
+  case INV:
+  case BUF:
+    return (cost2(co[i], 1));
+  case PO:
+    return (co[i]);
+  default:
+    return (SCOAP_INF);
+  }
+}
+
+/* SCOAP cost of detecting fault *fptr */
+int scoap_fault_cost(circuit_t *ckt, int *cc0, int *cc1, int *co,
+                     fault_list_t *fptr)
+{
+  int i = fptr->gate_index;
+  int line, o;
+
+  if (fptr->input_index < 0)
+  {
+    line = i;
+    o = co[i];
+  }
+  else
+  {
+    line = ckt->gate[i].fanin[fptr->input_index];
+    o = scoap_input_co(ckt, cc0, cc1, co, i, fptr->input_index);
+  }
+  return (cost2((fptr->type == S_A_0) ? cc1[line] : cc0[line], o));
+}
+
+/* qsort key: cost first, then canonical position */
+typedef struct rank_struct rank_t;
+struct rank_struct
+{
+  int cost;
+  int index;
+};
+
+static int rank_compare(const void *a, const void *b)
+{
+  const rank_t *ra = (const rank_t *)a;
+  const rank_t *rb = (const rank_t *)b;
+
+  if (ra->cost != rb->cost)
+    return ((ra->cost < rb->cost) ? -1 : 1);
+  return (ra->index - rb->index);
+}
+
+/*************************************************************************
+
+Function:  scoap_order
+
+Purpose:  Fills perm[] with the indices of faults[0..nfaults-1] from the
+easiest to the hardest fault, by SCOAP cost (ORDER_SCOAP) or by the number
+of levels between the fault site and the deepest level (ORDER_LEVEL).
+Ties keep their order.
+
+*************************************************************************/
+
+void scoap_order(circuit_t *ckt, fault_list_t **faults, int nfaults,
+                 int order, int *perm)
+{
+  psim_t *ps;
+  rank_t *rank;
+  int *cc0, *cc1, *co;
+  int f;
+
+  rank = (rank_t *)malloc((nfaults + 1) * sizeof(rank_t));
+  if (order == ORDER_LEVEL)
+  {
+    ps = psim_create(ckt);
+    for (f = 0; f < nfaults; f++)
+    {
+      rank[f].cost = ps->nlevels - ps->level[faults[f]->gate_index];
+      rank[f].index = f;
+    }
+    psim_free(ps);
+  }
+  else
+  {
+    cc0 = (int *)malloc(ckt->ngates * sizeof(int));
+    cc1 = (int *)malloc(ckt->ngates * sizeof(int));
+    co = (int *)malloc(ckt->ngates * sizeof(int));
+    scoap_measures(ckt, cc0, cc1, co);
+    for (f = 0; f < nfaults; f++)
+    {
+      rank[f].cost = scoap_fault_cost(ckt, cc0, cc1, co, faults[f]);
+      rank[f].index = f;
+    }
+    free(cc0);
+    free(cc1);
+    free(co);
+  }
+  qsort(rank, nfaults, sizeof(rank_t), rank_compare);
+  for (f = 0; f < nfaults; f++)
+    perm[f] = rank[f].index;
+  free(rank);
+}
+
+/* point the good values of ps at block b of the kept ones, or evaluate
+   the block again when it was not kept */
+static void use_block(psim_t *ps, pattern_t *pat, word_t *cache, int ncached,
+                      word_t *own_zero, word_t *own_one, int b)
+{
+  int n = pat->len - b * WORD_BITS;
+
+  if (b < ncached)
+  {
+    ps->zero = &cache[(size_t)b * 2 * ps->ckt->ngates];
+    ps->one = ps->zero + ps->ckt->ngates;
+    ps->valid = (n >= WORD_BITS) ? ALL_ONES : LANE(n) - 1;
+    return;
+  }
+  ps->zero = own_zero;
+  ps->one = own_one;
+  psim_load_patterns(ps, pat, b * WORD_BITS);
+  psim_good_eval(ps);
+}
+
+/* simulate the faults live[0..*nlive-1] against the current block, drop the
+   detected ones from live[] */
+static void simulate_live(psim_t *ps, fault_list_t **faults, char *detected,
+                          int *live, int *nlive, int first)
+{
+  inject_t inj;
+  word_t d;
+  int i, n, f;
+
+  for (n = 0, i = 0; i < *nlive; i++)
+  {
+    f = live[i];
+    psim_fault_inject(faults[f], &inj);
+    if ((d = psim_propagate(ps, &inj, 1)) != 0)
+    {
+      detected[f] = TRUE;
+      faults[f]->detect_index = first + lowest_lane(d);
+    }
+    else
+      live[n++] = f;
+  }
+  *nlive = n;
+}
+
+/*************************************************************************
+
+Function:  ordered_fault_simulate
+
+Purpose:  Same contract as parallel_fault_simulate(), but the faults are
+split by the easiest-to-hardest order (see scoap_order()) and the hard
+half sees the pattern blocks in the order of their detection yield.
+
+The first pass goes through the blocks in file order, fills pat.out[][]
+and keeps the good values of every block.  It simulates the easy half of
+the faults with dropping; most are caught by the first blocks.  A sample
+of YIELD_SAMPLE hard faults, spread over their order, is simulated
+against every block without dropping, so every block is ranked on the
+same faults by the number of lanes detecting them.  The second pass
+takes the other hard faults as one group through the blocks with the
+highest yield first, on the kept good values, so they are dropped after
+fewer blocks when the yield of the pattern file is uneven.  Blocks past
+ORDER_CACHE_BYTES of good values are evaluated again instead.  Detection
+does not depend on the order, so the undetected faults are those
+parallel_fault_simulate() leaves.
+
+Return:  List of faults that remain undetected, in their original order.
+
+*************************************************************************/
+
+fault_list_t *ordered_fault_simulate(circuit_t *ckt, pattern_t *pat,
+                                     fault_list_t *undetected_flist, int order)
+{
+  psim_t *ps;
+  fault_list_t **faults;
+  char *detected;
+  inject_t inj;
+  rank_t *block;
+  word_t d, *own_zero, *own_one, *cache;
+  int *perm, *easy, *hard, *sample, nfaults, nblocks, ncached, neasy, nhard,
+      nsample, f, j, b;
+
+  faults = psim_fault_array(undetected_flist, &nfaults);
+  detected = (char *)calloc(nfaults + 1, sizeof(char));
+  perm = (int *)malloc((nfaults + 1) * sizeof(int));
+  scoap_order(ckt, faults, nfaults, order, perm);
+
+  /* easy half, then the hard half with YIELD_SAMPLE of it set apart */
+  easy = perm;
+  neasy = nfaults / 2;
+  hard = (int *)malloc((nfaults - neasy + 1) * sizeof(int));
+  sample = (int *)malloc((YIELD_SAMPLE + 1) * sizeof(int));
+  nhard = nsample = 0;
+  for (j = neasy; j < nfaults; j++)
+  {
+    if (nsample < YIELD_SAMPLE &&
+        (long long)(j - neasy) * YIELD_SAMPLE >=
+            (long long)nsample * (nfaults - neasy))
+      sample[nsample++] = perm[j];
+    else
+      hard[nhard++] = perm[j];
+  }
+
+  nblocks = (pat->len + WORD_BITS - 1) / WORD_BITS;
+  block = (rank_t *)malloc((nblocks + 1) * sizeof(rank_t));
+  ncached = ORDER_CACHE_BYTES / (2 * sizeof(word_t) * ckt->ngates);
+  if (ncached > nblocks)
+    ncached = nblocks;
+  cache = (word_t *)malloc(((size_t)ncached * 2 * ckt->ngates + 1) *
+                           sizeof(word_t));
+
+  /* first pass: easy faults and the yield sample, blocks in file order */
+  ps = psim_create(ckt);
+  own_zero = ps->zero;
+  own_one = ps->one;
+  for (b = 0; b < nblocks; b++)
+  {
+    ps->zero = (b < ncached) ? &cache[(size_t)b * 2 * ckt->ngates] : own_zero;
+    ps->one = (b < ncached) ? ps->zero + ckt->ngates : own_one;
+    psim_load_patterns(ps, pat, b * WORD_BITS);
+    psim_good_eval(ps);
+    psim_store_outputs(ps, pat, b * WORD_BITS);
+    simulate_live(ps, faults, detected, easy, &neasy, b * WORD_BITS);
+    block[b].cost = 0;
+    block[b].index = b;
+    for (j = 0; j < nsample; j++)
+    {
+      f = sample[j];
+      psim_fault_inject(faults[f], &inj);
+      if ((d = psim_propagate(ps, &inj, 1)) == 0)
+        continue;
+      block[b].cost -= popcount(d);
+      if (!detected[f])
+      {
+        detected[f] = TRUE;
+        faults[f]->detect_index = b * WORD_BITS + lowest_lane(d);
+      }
+    }
+  }
+  qsort(block, nblocks, sizeof(rank_t), rank_compare);
+
+  /* second pass: the other hard faults as one group, best blocks first */
+  for (b = 0; b < nblocks && nhard > 0; b++)
+  {
+    use_block(ps, pat, cache, ncached, own_zero, own_one, block[b].index);
+    /* blocks out of order: a detecting pattern, maybe not the first */
+    simulate_live(ps, faults, detected, hard, &nhard,
+                  block[b].index * WORD_BITS);
+  }
+  ps->zero = own_zero;
+  ps->one = own_one;
+  psim_free(ps);
+
+  undetected_flist = psim_unlink_detected(faults, detected, nfaults);
+  free(faults);
+  free(detected);
+  free(perm);
+  free(hard);
+  free(sample);
+  free(block);
+  free(cache);
+  return (undetected_flist);
+}
@@ -0,0 +1,260 @@
+#include "project.h"
+#include "psim.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*
+ * Time-frame simulation of full-scan circuits.
+ *
+ * The pattern list is cut into sequences of "nframes" consecutive patterns.
+ * The first pattern of a sequence is scanned in whole; in every later frame
+ * only the true primary inputs are applied and each latch takes the value
+ * its pseudo PO had in the previous frame.  The primary outputs are
+ * observed in every frame and the latches are scanned out after the last
+ * frame of the sequence.
+ *
+ * Lane p of a block carries sequence p, so the frames of WORD_BITS sequences
+ * advance together.  Each frame has its own psim_t holding that frame's good
+ * values; the faulty state leaving a frame enters the next frame as
+ * injections on the pseudo PIs.
+ */
+
+/* load frame "t" of the sequences starting at "first", lane p holding
+   sequence first + p; return the lanes holding a pattern */
+static word_t load_frame(psim_t *ps, psim_t *prev, pattern_t *pat, int first,
+                         int t, int nframes)
+{
+  circuit_t *ckt = ps->ckt;
+  word_t valid;
+  int i, p, r, g;
+  int *row;
+
+  for (i = 0; i < ckt->npi; i++)
+  {
+    if (ckt->pi[i] < 0)
+      continue;
+    ps->zero[ckt->pi[i]] = 0;
+    ps->one[ckt->pi[i]] = 0;
+  }
+  valid = 0;
+  for (p = 0; p < WORD_BITS; p++)
+  {
+    r = (first + p) * nframes + t;
+    if (r >= pat->len)
+      break;
+    valid |= LANE(p);
+    row = pat->in[r];
+    for (i = 0; i < ckt->npi; i++)
+    {
+      if (ckt->pi[i] < 0)
+        continue;
+      if (row[i] == LOGIC_0)
+        ps->zero[ckt->pi[i]] |= LANE(p);
+      else if (row[i] == LOGIC_1)
+        ps->one[ckt->pi[i]] |= LANE(p);
+    }
+  }
+  /* the latches hold the state captured in the previous frame */
+  if (prev != NULL)
+  {
+    for (i = 0; i < ckt->nlatch; i++)
+    {
+      if ((g = ckt->ppi[i]) < 0)
+        continue;
+      ps->zero[g] = prev->zero[ckt->ppo[i]] & valid;
+      ps->one[g] = prev->one[ckt->ppo[i]] & valid;
+    }
+  }
+  ps->valid = valid;
+  return (valid);
+}
+
+/* copy the good primary output values of frame "t" into pat->out and, after
+   the first frame, the latch state applied into the pseudo PI columns
+   "col" of pat->in */
+static void store_frame(psim_t *ps, pattern_t *pat, int first, int t,
+                        int nframes, int *col)
+{
+  circuit_t *ckt = ps->ckt;
+  int j, p, r, g;
+
+  for (p = 0; p < WORD_BITS && (ps->valid & LANE(p)); p++)
+  {
+    r = (first + p) * nframes + t;
+    for (j = 0; t > 0 && j < ckt->nlatch; j++)
+    {
+      if (col[j] < 0)
+        continue;
+      g = ckt->ppi[j];
+      if (ps->one[g] & LANE(p))
+        pat->in[r][col[j]] = LOGIC_1;
+      else if (ps->zero[g] & LANE(p))
+        pat->in[r][col[j]] = LOGIC_0;
+      else
+        pat->in[r][col[j]] = LOGIC_X;
+    }
+    for (j = 0; j < ckt->npo; j++)
+    {
+      g = ckt->po[j];
+      if (ps->one[g] & LANE(p))
+        pat->out[r][j] = LOGIC_1;
+      else if (ps->zero[g] & LANE(p))
+        pat->out[r][j] = LOGIC_0;
+      else
+        pat->out[r][j] = LOGIC_X;
+    }
+  }
+}
+
+/*************************************************************************
+
+Function:  sequential_fault_simulate
+
+Purpose:  Same contract as parallel_fault_simulate(), but consecutive
+patterns are applied as sequences of nframes clock cycles with the latch
+state carried from one pattern to the next.  With nframes == 1 every
+pattern is a full-scan test of its own.
+
+pat.out[][] is filled with the fault-free output patterns corresponding to
+the input patterns in pat.in[][].  After the first frame of a sequence the
+pseudo PI columns of pat.in[][] are overwritten with the latch state
+actually applied, so the written patterns show what was simulated.
+
+Return:  List of faults that remain undetected, in their original order.
+
+*************************************************************************/
+
+fault_list_t *sequential_fault_simulate(circuit_t *ckt, pattern_t *pat,
+                                        fault_list_t *undetected_flist,
+                                        int nframes)
+{
+  psim_t **frame, *ps, *prev;
+  fault_list_t **faults;
+  inject_t *inj;
+  char *detected, *masked;
+  word_t *valid, detect, last, fz, fo, diff;
+  int nfaults, nseq, f, first, t, i, g, ninj;
+  int *latch, *col;
+
+  faults = psim_fault_array(undetected_flist, &nfaults);
+  detected = (char *)calloc(nfaults + 1, sizeof(char));
+  inj = (inject_t *)malloc((ckt->nlatch + 1) * sizeof(inject_t));
+  valid = (word_t *)malloc((nframes + 1) * sizeof(word_t));
+  valid[nframes] = 0;
+
+  /* pseudo POs are not observed directly; they are scanned out by hand at
+     the end of each sequence unless masked, and always feed the next frame */
+  masked = (char *)calloc(ckt->nlatch + 1, sizeof(char));
+  frame = (psim_t **)malloc(nframes * sizeof(psim_t *));
+  for (t = 0; t < nframes; t++)
+  {
+    frame[t] = psim_create(ckt);
+    for (i = 0; i < ckt->nlatch; i++)
+    {
+      g = ckt->ppo[i];
+      if (ckt->po_mask != NULL)
+        masked[i] = ckt->po_mask[frame[t]->po_pos[g]];
+      frame[t]->po_pos[g] = -1;
+      psim_observe_cone(frame[t], g);
+    }
+  }
+
+  /* pattern column of the pseudo PI of each latch */
+  latch = (int *)malloc((ckt->ngates + 1) * sizeof(int));
+  col = (int *)malloc((ckt->nlatch + 1) * sizeof(int));
+  for (g = 0; g < ckt->ngates; g++)
+    latch[g] = -1;
+  for (i = 0; i < ckt->nlatch; i++)
+  {
+    col[i] = -1;
+    if (ckt->ppi[i] >= 0)
+      latch[ckt->ppi[i]] = i;
+  }
+  for (i = 0; i < ckt->npi; i++)
+  {
+    if (ckt->pi[i] >= 0 && latch[ckt->pi[i]] >= 0)
+      col[latch[ckt->pi[i]]] = i;
+  }
+  free(latch);
+
+  nseq = (pat->len + nframes - 1) / nframes;
+  for (first = 0; first < nseq; first += WORD_BITS)
+  {
+    for (t = 0; t < nframes; t++)
+    {
+      valid[t] = load_frame(frame[t], (t > 0) ? frame[t - 1] : NULL, pat,
+                            first, t, nframes);
+      psim_good_eval(frame[t]);
+      store_frame(frame[t], pat, first, t, nframes, col);
+    }
+    for (f = 0; f < nfaults; f++)
+    {
+      if (detected[f])
+        continue;
+      detect = 0;
+      for (t = 0; t < nframes && valid[t] != 0 && detect == 0; t++)
+      {
+        ps = frame[t];
+        /* the fault comes first so that it wins over the carried state */
+        psim_fault_inject(faults[f], &inj[0]);
+        ninj = 1;
+        if (t > 0)
+        {
+          prev = frame[t - 1];
+          for (i = 0; i < ckt->nlatch; i++)
+          {
+            g = ckt->ppo[i];
+            if (ckt->ppi[i] < 0 || prev->stamp[g] != prev->now)
+              continue;
+            diff = ((prev->fzero[g] ^ prev->zero[g]) |
+                    (prev->fone[g] ^ prev->one[g])) & valid[t];
+            if (diff == 0)
+              continue;
+            inj[ninj].gate_index = ckt->ppi[i];
+            inj[ninj].input_index = -1;
+            inj[ninj].lanes = diff;
+            inj[ninj].zero = prev->fzero[g];
+            inj[ninj].one = prev->fone[g];
+            ninj++;
+          }
+        }
+        detect = psim_propagate(ps, inj, ninj);
+
+        /* scan out the sequences ending in this frame */
+        last = valid[t] & ~valid[t + 1];
+        for (i = 0; i < ckt->nlatch && last != 0; i++)
+        {
+          g = ckt->ppo[i];
+          if (masked[i] || ps->stamp[g] != ps->now)
+            continue;
+          fz = ps->fzero[g];
+          fo = ps->fone[g];
+          detect |= ((ps->one[g] & fz) | (ps->zero[g] & fo)) & last;
+        }
+      }
+      /* frame t of the lowest sequence detecting there; an earlier frame
+         of a later sequence is not looked at */
+      if (detect)
+      {
+        detected[f] = TRUE;
+        faults[f]->detect_index =
+            (first + lowest_lane(detect)) * nframes + t - 1;
+      }
+    }
+  }
+  for (t = 0; t < nframes; t++)
+    psim_free(frame[t]);
+  free(frame);
+  free(masked);
+
+  undetected_flist = psim_unlink_detected(faults, detected, nfaults);
+  free(faults);
+  free(detected);
+  free(inj);
+  free(valid);
+  free(col);
+  return (undetected_flist);
+}
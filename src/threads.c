@@ -0,0 +1,393 @@
+#include "project.h"
+#include "psim.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+/*
+ * Multi-threaded fault simulation.
+ *
+ * Fault partitioning: the pattern blocks are taken in order, and each one
+ * is good simulated once into a simulator all threads read.  The faults
+ * still undetected are cut into batches of POOL_BATCH.  Each thread
+ * propagates them through a clone of its own, so nothing is written that
+ * another thread reads.  A few hard faults can cost more than all the
+ * rest, so a static split leaves threads idle.  Each thread therefore owns
+ * a deque of batches, works from its bottom, and once it is empty steals
+ * from the top of the others'.  A fault is simulated by one thread per
+ * block, and it is dropped between blocks in list order, so the result
+ * does not depend on the schedule.
+ *
+ * Pattern partitioning: every thread has a whole simulator of its own and
+ * claims the next pattern block from a shared counter.  It good simulates
+ * the block and runs all its live faults against it.  A detected fault is
+ * set in a bitmap shared by all threads with an atomic OR.  Threads test
+ * that bitmap before they start a fault and then drop it from their own
+ * live list, so no thread waits on another.  A fault is skipped only once
+ * some block has detected it, so the undetected faults are the same.  The
+ * block that drops a fault may not be the first to detect it, though, so
+ * its detect_index is a detecting pattern but not always the first.
+ */
+
+#define POOL_BATCH 16 /* faults per batch */
+
+typedef struct deque_struct deque_t;
+struct deque_struct
+{
+  pthread_mutex_t lock;
+  int *batch; /* batch numbers, taken from [top, bottom) */
+  int top;
+  int bottom;
+};
+
+typedef struct pool_struct pool_t;
+typedef struct worker_struct worker_t;
+struct worker_struct
+{
+  pool_t *pool;
+  int id;
+  psim_t *ps;
+  pthread_t thread;
+};
+
+struct pool_struct
+{
+  int nthreads;
+  worker_t *worker;
+  deque_t *deque;
+  pthread_barrier_t start; /* a block is ready, or done is set */
+  pthread_barrier_t finish; /* every batch of the block is simulated */
+  int done;
+  psim_t *good;            /* good machine of the current block */
+  int first;               /* its first pattern */
+  fault_list_t **faults;
+  char *detected;
+  int *live;               /* undetected faults, in list order */
+  int nlive;
+};
+
+/* next batch for worker w: its own newest, else the oldest of another */
+static int next_batch(pool_t *pool, int w)
+{
+  deque_t *dq;
+  int v, b = -1;
+
+  dq = &pool->deque[w];
+  pthread_mutex_lock(&dq->lock);
+  if (dq->bottom > dq->top)
+    b = dq->batch[--dq->bottom];
+  pthread_mutex_unlock(&dq->lock);
+  for (v = (w + 1) % pool->nthreads; b < 0 && v != w;
+       v = (v + 1) % pool->nthreads)
+  {
+    dq = &pool->deque[v];
+    pthread_mutex_lock(&dq->lock);
+    if (dq->bottom > dq->top)
+      b = dq->batch[dq->top++];
+    pthread_mutex_unlock(&dq->lock);
+  }
+  return (b);
+}
+
+/* simulate batches of the current block until none is left anywhere */
+static void run_block(worker_t *wk)
+{
+  pool_t *pool = wk->pool;
+  inject_t inj;
+  word_t d;
+  int b, i, f, end;
+
+  wk->ps->valid = pool->good->valid;
+  while ((b = next_batch(pool, wk->id)) >= 0)
+  {
+    end = (b + 1) * POOL_BATCH;
+    if (end > pool->nlive)
+      end = pool->nlive;
+    for (i = b * POOL_BATCH; i < end; i++)
+    {
+      f = pool->live[i];
+      psim_fault_inject(pool->faults[f], &inj);
+      if ((d = psim_propagate(wk->ps, &inj, 1)) != 0)
+      {
+        pool->detected[f] = TRUE;
+        pool->faults[f]->detect_index = pool->first + lowest_lane(d);
+      }
+    }
+  }
+}
+
+static void *worker_main(void *arg)
+{
+  worker_t *wk = (worker_t *)arg;
+  pool_t *pool = wk->pool;
+
+  for (;;)
+  {
+    pthread_barrier_wait(&pool->start);
+    if (pool->done)
+      break;
+    run_block(wk);
+    pthread_barrier_wait(&pool->finish);
+  }
+  return (NULL);
+}
+
+/* deal the batches of the live faults out in contiguous runs */
+static void deal_batches(pool_t *pool)
+{
+  deque_t *dq;
+  int nbatches, per, w, b;
+
+  nbatches = (pool->nlive + POOL_BATCH - 1) / POOL_BATCH;
+  per = (nbatches + pool->nthreads - 1) / pool->nthreads;
+  for (w = 0; w < pool->nthreads; w++)
+  {
+    dq = &pool->deque[w];
+    dq->top = dq->bottom = 0;
+    for (b = w * per; b < nbatches && b < (w + 1) * per; b++)
+      dq->batch[dq->bottom++] = b;
+  }
+}
+
+/*************************************************************************
+
+Function:  threaded_fault_simulate
+
+Purpose:  Same contract as parallel_fault_simulate(), with the faults of
+each pattern block spread over "nthreads" threads (see above).  The
+calling thread is one of them.
+
+Return:  List of faults that remain undetected, in their original order.
+
+*************************************************************************/
+
+fault_list_t *threaded_fault_simulate(circuit_t *ckt, pattern_t *pat,
+                                      fault_list_t *undetected_flist,
+                                      int nthreads)
+{
+  pool_t pool;
+  int nfaults, per, f, w, i, n;
+
+  memset(&pool, 0, sizeof(pool));
+  pool.nthreads = nthreads;
+  pool.faults = psim_fault_array(undetected_flist, &nfaults);
+  pool.detected = (char *)calloc(nfaults + 1, sizeof(char));
+  pool.live = (int *)malloc((nfaults + 1) * sizeof(int));
+  for (f = 0; f < nfaults; f++)
+    pool.live[f] = f;
+  pool.nlive = nfaults;
+
+  pool.good = psim_create(ckt);
+  pool.worker = (worker_t *)malloc(nthreads * sizeof(worker_t));
+  pool.deque = (deque_t *)malloc(nthreads * sizeof(deque_t));
+  per = ((nfaults + POOL_BATCH - 1) / POOL_BATCH + nthreads - 1) / nthreads;
+  for (w = 0; w < nthreads; w++)
+  {
+    pthread_mutex_init(&pool.deque[w].lock, NULL);
+    pool.deque[w].batch = (int *)malloc((per + 1) * sizeof(int));
+    pool.worker[w].pool = &pool;
+    pool.worker[w].id = w;
+    pool.worker[w].ps = psim_clone(pool.good);
+  }
+  pthread_barrier_init(&pool.start, NULL, nthreads);
+  pthread_barrier_init(&pool.finish, NULL, nthreads);
+  for (w = 1; w < nthreads; w++)
+  {
+    if (pthread_create(&pool.worker[w].thread, NULL, worker_main,
+                       &pool.worker[w]) != 0)
+    {
+      fprintf(stderr, "ERROR:  can't start thread %d\n", w);
+      exit(-1);
+    }
+  }
+
+  for (pool.first = 0; pool.first < pat->len; pool.first += WORD_BITS)
+  {
+    psim_load_patterns(pool.good, pat, pool.first);
+    psim_good_eval(pool.good);
+    psim_store_outputs(pool.good, pat, pool.first);
+    if (pool.nlive == 0)
+      continue;
+    deal_batches(&pool);
+    pthread_barrier_wait(&pool.start);
+    run_block(&pool.worker[0]);
+    pthread_barrier_wait(&pool.finish);
+    /* drop the faults detected in this block */
+    for (n = 0, i = 0; i < pool.nlive; i++)
+    {
+      if (!pool.detected[pool.live[i]])
+        pool.live[n++] = pool.live[i];
+    }
+    pool.nlive = n;
+  }
+  pool.done = TRUE;
+  pthread_barrier_wait(&pool.start);
+  for (w = 1; w < nthreads; w++)
+    pthread_join(pool.worker[w].thread, NULL);
+  pthread_barrier_destroy(&pool.start);
+  pthread_barrier_destroy(&pool.finish);
+  for (w = 0; w < nthreads; w++)
+  {
+    psim_free(pool.worker[w].ps);
+    pthread_mutex_destroy(&pool.deque[w].lock);
+    free(pool.deque[w].batch);
+  }
+  psim_free(pool.good);
+
+  undetected_flist = psim_unlink_detected(pool.faults, pool.detected, nfaults);
+  free(pool.worker);
+  free(pool.deque);
+  free(pool.faults);
+  free(pool.detected);
+  free(pool.live);
+  return (undetected_flist);
+}
+
+/* pattern-partitioned threads share this */
+typedef struct share_struct share_t;
+struct share_struct
+{
+  circuit_t *ckt;
+  pattern_t *pat;
+  fault_list_t **faults;
+  int nfaults;
+  word_t *dropped;   /* bitmap of the detected faults, set atomically */
+  int *first;        /* lowest detecting pattern found, -1 if none */
+  int next_block;    /* claimed with an atomic add */
+};
+
+typedef struct part_struct part_t;
+struct part_struct
+{
+  share_t *share;
+  psim_t *ps;
+  pthread_t thread;
+};
+
+#define DROPPED(sh, f)                                                        \
+  ((__atomic_load_n(&(sh)->dropped[(f) / WORD_BITS], __ATOMIC_RELAXED) >>      \
+    ((f) % WORD_BITS)) & 1)
+
+/* record pattern p as detecting fault f, keeping the lowest */
+static void detect_fault(share_t *sh, int f, int p)
+{
+  int old;
+
+  __atomic_fetch_or(&sh->dropped[f / WORD_BITS], LANE(f % WORD_BITS),
+                    __ATOMIC_RELAXED);
+  old = __atomic_load_n(&sh->first[f], __ATOMIC_RELAXED);
+  while ((old < 0 || p < old) &&
+         !__atomic_compare_exchange_n(&sh->first[f], &old, p, FALSE,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+}
+
+static void *part_main(void *arg)
+{
+  part_t *pt = (part_t *)arg;
+  share_t *sh = pt->share;
+  inject_t inj;
+  word_t d;
+  int *live, nlive, first, i, n, f;
+
+  live = (int *)malloc((sh->nfaults + 1) * sizeof(int));
+  for (nlive = 0; nlive < sh->nfaults; nlive++)
+    live[nlive] = nlive;
+  for (;;)
+  {
+    first = __atomic_fetch_add(&sh->next_block, 1, __ATOMIC_RELAXED) *
+            WORD_BITS;
+    if (first >= sh->pat->len)
+      break;
+    psim_load_patterns(pt->ps, sh->pat, first);
+    psim_good_eval(pt->ps);
+    psim_store_outputs(pt->ps, sh->pat, first);
+    for (n = 0, i = 0; i < nlive; i++)
+    {
+      f = live[i];
+      if (DROPPED(sh, f))
+        continue;
+      psim_fault_inject(sh->faults[f], &inj);
+      if ((d = psim_propagate(pt->ps, &inj, 1)) != 0)
+        detect_fault(sh, f, first + lowest_lane(d));
+      else
+        live[n++] = f;
+    }
+    nlive = n;
+  }
+  free(live);
+  return (NULL);
+}
+
+/*************************************************************************
+
+Function:  pattern_threaded_fault_simulate
+
+Purpose:  Same contract as parallel_fault_simulate(), with the pattern
+blocks spread over "nthreads" threads that share a fault-drop bitmap (see
+above).  The calling thread is one of them.
+
+Return:  List of faults that remain undetected, in their original order.
+
+*************************************************************************/
+
+fault_list_t *pattern_threaded_fault_simulate(circuit_t *ckt, pattern_t *pat,
+                                              fault_list_t *undetected_flist,
+                                              int nthreads)
+{
+  share_t share;
+  part_t *part;
+  char *detected;
+  int f, w;
+
+  memset(&share, 0, sizeof(share));
+  share.ckt = ckt;
+  share.pat = pat;
+  share.faults = psim_fault_array(undetected_flist, &share.nfaults);
+  share.dropped = (word_t *)calloc(share.nfaults / WORD_BITS + 1,
+                                   sizeof(word_t));
+  share.first = (int *)malloc((share.nfaults + 1) * sizeof(int));
+  for (f = 0; f < share.nfaults; f++)
+    share.first[f] = -1;
+
+  part = (part_t *)malloc(nthreads * sizeof(part_t));
+  for (w = 0; w < nthreads; w++)
+  {
+    part[w].share = &share;
+    part[w].ps = psim_create(ckt);
+  }
+  for (w = 1; w < nthreads; w++)
+  {
+    if (pthread_create(&part[w].thread, NULL, part_main, &part[w]) != 0)
+    {
+      fprintf(stderr, "ERROR:  can't start thread %d\n", w);
+      exit(-1);
+    }
+  }
+  part_main(&part[0]);
+  for (w = 1; w < nthreads; w++)
+    pthread_join(part[w].thread, NULL);
+  for (w = 0; w < nthreads; w++)
+    psim_free(part[w].ps);
+
+  detected = (char *)calloc(share.nfaults + 1, sizeof(char));
+  for (f = 0; f < share.nfaults; f++)
+  {
+    if (share.first[f] >= 0)
+    {
+      detected[f] = TRUE;
+      share.faults[f]->detect_index = share.first[f];
+    }
+  }
+  undetected_flist = psim_unlink_detected(share.faults, detected,
+                                          share.nfaults);
+  free(detected);
+  free(part);
+  free(share.faults);
+  free(share.dropped);
+  free(share.first);
+  return (undetected_flist);
+}
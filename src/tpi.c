@@ -0,0 +1,388 @@
+#include "project.h"
+#include "psim.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*
+ * Test point what-if analysis.
+ *
+ * An observation point on gate g detects every fault whose effect reaches
+ * g as a hard 0/1 flip under some pattern.  One sweep of the undetected
+ * faults over the pattern blocks reads that off the gates each propagation
+ * stamps, for every gate at once.
+ *
+ * A control point forces a line to a constant while a test mode signal is
+ * asserted; it is assumed to be applied with the same patterns in a session
+ * of its own, so it cannot lose a detection.  The same sweep screens the
+ * candidates: an effect that dies at a gate whose side input holds the
+ * controlling value votes for a control point setting that input to the
+ * non-controlling one.  The best-voted candidates are then simulated
+ * exactly, against the good machine with the control point applied.
+ *
+ * Gains are counted in faults and a greedy cover picks the top points.
+ */
+
+#define TP_OBSERVE 0
+#define TP_CONTROL_0 1
+#define TP_CONTROL_1 2
+#define TP_SCREEN 4 /* control points verified per point asked for */
+
+/* gate i is a primary output left unmasked */
+#define observed_po(ps, i)                                                    \
+  ((ps)->po_pos[i] >= 0 &&                                                    \
+   ((ps)->ckt->po_mask == NULL || !(ps)->ckt->po_mask[(ps)->po_pos[i]]))
+
+typedef struct point_struct point_t;
+struct point_struct
+{
+  int gate;
+  int kind;    /* TP_OBSERVE, TP_CONTROL_0 or TP_CONTROL_1 */
+  int nfaults; /* faults the point detects */
+  int cap;
+  int *faults; /* their indices, ascending once squeezed */
+};
+
+static int int_compare(const void *a, const void *b)
+{
+  return (*(const int *)a - *(const int *)b);
+}
+
+/* sort the fault indices of a point and drop repeats */
+static void point_squeeze(point_t *pt)
+{
+  int i, n;
+
+  if (pt->nfaults < 2)
+    return;
+  qsort(pt->faults, pt->nfaults, sizeof(int), int_compare);
+  for (n = 1, i = 1; i < pt->nfaults; i++)
+  {
+    if (pt->faults[i] != pt->faults[n - 1])
+      pt->faults[n++] = pt->faults[i];
+  }
+  pt->nfaults = n;
+}
+
+/* add fault f to a point; the same fault shows up again in later blocks,
+   so a full list is squeezed before it grows */
+static void point_add(point_t *pt, int f)
+{
+  if (pt->nfaults > 0 && pt->faults[pt->nfaults - 1] == f)
+    return;
+  if (pt->nfaults == pt->cap)
+  {
+    point_squeeze(pt);
+    if (2 * pt->nfaults >= pt->cap)
+    {
+      pt->cap = (pt->cap == 0) ? 8 : 2 * pt->cap;
+      pt->faults = (int *)realloc(pt->faults, pt->cap * sizeof(int));
+    }
+  }
+  pt->faults[pt->nfaults++] = f;
+}
+
+/* qsort key: more faults first, then gate order */
+static int point_compare(const void *a, const void *b)
+{
+  const point_t *pa = *(const point_t **)a;
+  const point_t *pb = *(const point_t **)b;
+
+  if (pa->nfaults != pb->nfaults)
+    return (pb->nfaults - pa->nfaults);
+  if (pa->gate != pb->gate)
+    return (pa->gate - pb->gate);
+  return (pa->kind - pb->kind);
+}
+
+/* the sweep: observation points of every gate and control point votes */
+static void sweep(psim_t *ps, pattern_t *pat, fault_list_t **faults,
+                  int nfaults, point_t *obs, int *votes)
+{
+  circuit_t *ckt = ps->ckt;
+  gate_t *g;
+  inject_t inj;
+  word_t flip, sz, so;
+  int *voter, first, f, e, h, j, k, s, c, tag;
+
+  voter = (int *)calloc(2 * ckt->ngates, sizeof(int));
+  tag = 0;
+  for (first = 0; first < pat->len; first += WORD_BITS)
+  {
+    psim_load_patterns(ps, pat, first);
+    psim_good_eval(ps);
+    for (f = 0; f < nfaults; f++)
+    {
+      psim_fault_inject(faults[f], &inj);
+      psim_propagate(ps, &inj, 1);
+      tag++;
+      for (e = 0; e < ps->nevents; e++)
+      {
+        h = ps->events[e];
+        flip = ((ps->one[h] & ps->fzero[h]) | (ps->zero[h] & ps->fone[h])) &
+               ps->valid;
+        if (flip == 0)
+          continue;
+        if (ckt->gate[h].type != PO)
+          point_add(&obs[h], f);
+
+        /* fanouts where the flip dies on a controlling side input */
+        for (j = 0; j < ckt->gate[h].num_fanout; j++)
+        {
+          k = ckt->gate[h].fanout[j];
+          g = &ckt->gate[k];
+          if (ps->stamp[k] == ps->now || g->type == PO || g->type == BUF ||
+              g->type == INV)
+            continue;
+          s = (g->fanin[0] == h) ? g->fanin[1] : g->fanin[0];
+          if (s == h)
+            continue;
+          sz = (ps->stamp[s] == ps->now) ? ps->fzero[s] : ps->zero[s];
+          so = (ps->stamp[s] == ps->now) ? ps->fone[s] : ps->one[s];
+          if (g->type == AND || g->type == NAND)
+            c = (sz & flip) ? 2 * s + 1 : -1;
+          else
+            c = (so & flip) ? 2 * s : -1;
+          if (c >= 0 && voter[c] != tag)
+          {
+            voter[c] = tag;
+            votes[c]++;
+          }
+        }
+      }
+    }
+  }
+  free(voter);
+}
+
+/* exact gain of a control point: faults whose faulty machine differs at a
+   primary output from the good machine with the point applied */
+static void verify_control(psim_t *ps, pattern_t *pat, fault_list_t **faults,
+                           int nfaults, point_t *pt, word_t *snap_z,
+                           word_t *snap_o, int *snap, int *run, int *po1)
+{
+  inject_t inj[2];
+  char *detected;
+  word_t d, gz, go;
+  int first, f, e, p, n1, q;
+
+  detected = (char *)calloc(nfaults + 1, sizeof(char));
+  inj[0].gate_index = pt->gate;
+  inj[0].input_index = -1;
+  inj[0].lanes = ALL_ONES;
+  inj[0].zero = (pt->kind == TP_CONTROL_0) ? ALL_ONES : 0;
+  inj[0].one = (pt->kind == TP_CONTROL_1) ? ALL_ONES : 0;
+  for (first = 0; first < pat->len; first += WORD_BITS)
+  {
+    psim_load_patterns(ps, pat, first);
+    psim_good_eval(ps);
+
+    /* good machine with the control point, at the outputs it changes */
+    psim_propagate(ps, inj, 1);
+    (*run)++;
+    for (n1 = 0, e = 0; e < ps->nevents; e++)
+    {
+      p = ps->events[e];
+      if (!observed_po(ps, p))
+        continue;
+      snap_z[p] = ps->fzero[p];
+      snap_o[p] = ps->fone[p];
+      snap[p] = *run;
+      po1[n1++] = p;
+    }
+
+    /* control point dominates a fault on the same line: inj[0] is
+       applied last */
+    for (f = 0; f < nfaults; f++)
+    {
+      if (detected[f])
+        continue;
+      psim_fault_inject(faults[f], &inj[1]);
+      psim_propagate(ps, inj, 2);
+      d = 0;
+      for (e = 0; e < ps->nevents; e++)
+      {
+        p = ps->events[e];
+        if (!observed_po(ps, p))
+          continue;
+        gz = (snap[p] == *run) ? snap_z[p] : ps->zero[p];
+        go = (snap[p] == *run) ? snap_o[p] : ps->one[p];
+        d |= (gz & ps->fone[p]) | (go & ps->fzero[p]);
+      }
+      for (q = 0; q < n1; q++)
+      {
+        p = po1[q];
+        if (ps->stamp[p] != ps->now)
+          d |= (snap_z[p] & ps->one[p]) | (snap_o[p] & ps->zero[p]);
+      }
+      if (d & ps->valid)
+      {
+        detected[f] = TRUE;
+        point_add(pt, f);
+      }
+    }
+  }
+  free(detected);
+}
+
+static void write_point(circuit_t *ckt, point_t *pt, FILE *out_file)
+{
+  if (pt->kind == TP_OBSERVE)
+    fprintf(out_file, "Observe Gate %s", ckt->gate[pt->gate].name);
+  else
+    fprintf(out_file, "Control Gate %s to %d", ckt->gate[pt->gate].name,
+            (pt->kind == TP_CONTROL_1) ? 1 : 0);
+}
+
+/*************************************************************************
+
+Function:  test_point_analysis
+
+Purpose:  Evaluates observation and control points for the faults left
+undetected by the patterns in pat (see above) and appends to out_file the
+gain of every candidate that detects some of them, then a greedy choice
+of up to "k" points with the fault coverage reached after each.
+num_faults and num_missed are the totals the coverage is taken from.
+
+*************************************************************************/
+
+void test_point_analysis(circuit_t *ckt, pattern_t *pat,
+                         fault_list_t *undetected_flist, int num_faults,
+                         int num_missed, int k, FILE *out_file)
+{
+  psim_t *ps;
+  fault_list_t **faults;
+  point_t *obs, *ctl, **list;
+  word_t *snap_z, *snap_o;
+  char *covered;
+  int *votes, *snap, *po1, *count;
+  int nfaults, ncand, nctl, nlist, run, f, i, c, best, left, picked;
+
+  faults = psim_fault_array(undetected_flist, &nfaults);
+  obs = (point_t *)calloc(ckt->ngates, sizeof(point_t));
+  votes = (int *)calloc(2 * ckt->ngates, sizeof(int));
+  for (i = 0; i < ckt->ngates; i++)
+  {
+    obs[i].gate = i;
+    obs[i].kind = TP_OBSERVE;
+  }
+
+  /* an observation point may sit behind masked outputs, so every gate is
+     simulated and the masked outputs are skipped by hand */
+  ps = psim_create(ckt);
+  memset(ps->observe, TRUE, ckt->ngates);
+  sweep(ps, pat, faults, nfaults, obs, votes);
+
+  /* best-voted control points, verified */
+  for (ncand = 0, c = 0; c < 2 * ckt->ngates; c++)
+  {
+    if (votes[c] > 0)
+      ncand++;
+  }
+  nctl = (ncand < TP_SCREEN * k) ? ncand : TP_SCREEN * k;
+  ctl = (point_t *)calloc(nctl + 1, sizeof(point_t));
+  for (i = 0; i < nctl; i++)
+  {
+    best = -1;
+    for (c = 0; c < 2 * ckt->ngates; c++)
+    {
+      if (votes[c] > 0 && (best < 0 || votes[c] > votes[best]))
+        best = c;
+    }
+    votes[best] = 0;
+    ctl[i].gate = best / 2;
+    ctl[i].kind = (best % 2) ? TP_CONTROL_1 : TP_CONTROL_0;
+  }
+  snap_z = (word_t *)malloc(ckt->ngates * sizeof(word_t));
+  snap_o = (word_t *)malloc(ckt->ngates * sizeof(word_t));
+  snap = (int *)calloc(ckt->ngates, sizeof(int));
+  po1 = (int *)malloc(ckt->ngates * sizeof(int));
+  run = 0;
+  for (i = 0; i < nctl; i++)
+    verify_control(ps, pat, faults, nfaults, &ctl[i], snap_z, snap_o, snap,
+                   &run, po1);
+  psim_free(ps);
+
+  /* every candidate with a gain */
+  list = (point_t **)malloc((ckt->ngates + nctl + 1) * sizeof(point_t *));
+  nlist = 0;
+  for (i = 0; i < ckt->ngates; i++)
+  {
+    point_squeeze(&obs[i]);
+    if (obs[i].nfaults > 0)
+      list[nlist++] = &obs[i];
+  }
+  for (i = 0; i < nctl; i++)
+  {
+    point_squeeze(&ctl[i]);
+    if (ctl[i].nfaults > 0)
+      list[nlist++] = &ctl[i];
+  }
+  qsort(list, nlist, sizeof(point_t *), point_compare);
+  fprintf(out_file, "List of Test Point Candidates:\n");
+  if (nlist == 0)
+    fprintf(out_file, "(Empty)\n");
+  for (i = 0; i < nlist; i++)
+  {
+    write_point(ckt, list[i], out_file);
+    fprintf(out_file, " - %d faults\n", list[i]->nfaults);
+  }
+  fprintf(out_file, "Number of Control Points Simulated = %d of %d voted\n",
+          nctl, ncand);
+
+  /* lazy greedy cover, as in compaction */
+  fprintf(out_file, "\nSelected Test Points:\n");
+  covered = (char *)calloc(nfaults + 1, sizeof(char));
+  count = (int *)malloc((nlist + 1) * sizeof(int));
+  for (i = 0; i < nlist; i++)
+    count[i] = list[i]->nfaults;
+  left = num_missed;
+  for (picked = 0; picked < k;)
+  {
+    best = -1;
+    for (i = 0; i < nlist; i++)
+    {
+      if (count[i] > 0 && (best < 0 || count[i] > count[best]))
+        best = i;
+    }
+    if (best < 0)
+      break;
+    for (c = 0, f = 0; f < list[best]->nfaults; f++)
+      c += !covered[list[best]->faults[f]];
+    if (c < count[best])
+    {
+      count[best] = c;
+      continue;
+    }
+    for (f = 0; f < list[best]->nfaults; f++)
+      covered[list[best]->faults[f]] = TRUE;
+    count[best] = 0;
+    left -= c;
+    picked++;
+    write_point(ckt, list[best], out_file);
+    fprintf(out_file, " - %d more faults, Fault Coverage = %d.%d%%\n", c,
+            ((num_faults - left) * 100) / num_faults,
+            ((num_faults - left) * 1000 / num_faults) % 10);
+  }
+  if (picked == 0)
+    fprintf(out_file, "(Empty)\n");
+  fprintf(out_file, "\n");
+
+  for (i = 0; i < ckt->ngates; i++)
+    free(obs[i].faults);
+  for (i = 0; i < nctl; i++)
+    free(ctl[i].faults);
+  free(obs);
+  free(ctl);
+  free(list);
+  free(faults);
+  free(votes);
+  free(snap_z);
+  free(snap_o);
+  free(snap);
+  free(po1);
+  free(covered);
+  free(count);
+}
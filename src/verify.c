@@ -0,0 +1,339 @@
+#include "project.h"
+#include "psim.h"
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/*
+ * Streaming good simulation: expected-response verification and
+ * response-only simulation.
+ *
+ * The pattern file is read one 64-pattern block at a time, so its size is
+ * not bounded by MAX_PATTERNS or by memory.  Lines are parsed straight into
+ * two-rail input and expected words, without pattern rows in between, and
+ * each block is good simulated once.  For verification, an expected X
+ * matches anything; an expected 0 or 1 must be simulated exactly, so a
+ * simulated X against it is a mismatch.  The whole block is compared a
+ * word at a time.
+ */
+
+/* value of a character of a pattern line, -1 if none */
+static int value_of(int c)
+{
+  switch (c)
+  {
+  case '0':
+    return (LOGIC_0);
+  case '1':
+    return (LOGIC_1);
+  case '2':
+  case 'X':
+  case 'x':
+    return (LOGIC_X);
+  default:
+    return (-1);
+  }
+}
+
+static int value_char(word_t zero, word_t one, int p)
+{
+  if (one & LANE(p))
+    return ('1');
+  if (zero & LANE(p))
+    return ('0');
+  return ('X');
+}
+
+/* parses the inputs at the start of a line into lane p of izero/ione and,
+   unless NULL, normalized into text[]; returns the rest of the line, or
+   NULL if the line does not start with a value, i.e. holds no pattern */
+static char *parse_inputs(circuit_t *ckt, signed char *vtab, char *line,
+                          int line_count, word_t *izero, word_t *ione, int p,
+                          char *text)
+{
+  char *s;
+  int i, v;
+
+  for (s = line; *s == ' ' || *s == '\t'; s++)
+    ;
+  if (vtab[(unsigned char)*s] < 0)
+    return (NULL);
+  for (i = 0; i < ckt->npi; i++, s++)
+  {
+    if ((v = vtab[(unsigned char)*s]) < 0)
+    {
+      fprintf(stderr, "ERROR:  line %d needs %d input values\n", line_count,
+              ckt->npi);
+      exit(-1);
+    }
+    izero[i] |= (word_t)(v == LOGIC_0) << p;
+    ione[i] |= (word_t)(v == LOGIC_1) << p;
+    if (text != NULL)
+      text[i] = (char)('0' + v);
+  }
+  return (s);
+}
+
+/* parses "-> outputs" after the inputs into lane p of ezero/eone */
+static void parse_expected(circuit_t *ckt, signed char *vtab, char *s,
+                           int line_count, word_t *ezero, word_t *eone, int p)
+{
+  int j, v;
+
+  for (; *s == ' ' || *s == '\t'; s++)
+    ;
+  if (s[0] != '-' || s[1] != '>')
+  {
+    fprintf(stderr, "ERROR:  line %d needs \"->\" after the inputs\n",
+            line_count);
+    exit(-1);
+  }
+  for (s += 2; *s == ' ' || *s == '\t'; s++)
+    ;
+  for (j = 0; j < ckt->npo; j++, s++)
+  {
+    if ((v = vtab[(unsigned char)*s]) < 0)
+    {
+      fprintf(stderr, "ERROR:  line %d needs %d expected output values\n",
+              line_count, ckt->npo);
+      exit(-1);
+    }
+    ezero[j] |= (word_t)(v == LOGIC_0) << p;
+    eone[j] |= (word_t)(v == LOGIC_1) << p;
+  }
+}
+
+/* reads the next line of pat_file into line[], FALSE at the end */
+static int next_line(FILE *pat_file, char *line, int line_size,
+                     int *line_count)
+{
+  if (fgets(line, line_size, pat_file) == NULL)
+    return (FALSE);
+  (*line_count)++;
+  if (strchr(line, '\n') == NULL && !feof(pat_file))
+  {
+    fprintf(stderr, "ERROR:  line %d is too long\n", *line_count);
+    exit(-1);
+  }
+  return (TRUE);
+}
+
+/* places the input words of a block of n patterns on the PIs of ps */
+static void load_block(psim_t *ps, word_t *izero, word_t *ione, int n)
+{
+  circuit_t *ckt = ps->ckt;
+  int i;
+
+  for (i = 0; i < ckt->npi; i++)
+  {
+    if (ckt->pi[i] < 0)
+      continue;
+    ps->zero[ckt->pi[i]] = izero[i];
+    ps->one[ckt->pi[i]] = ione[i];
+  }
+  ps->valid = (n == WORD_BITS) ? ALL_ONES : LANE(n) - 1;
+}
+
+/*************************************************************************
+
+Function:  verify_responses
+
+Purpose:  Reads patterns with their expected responses from pat_file, one
+"inputs -> outputs" line per pattern as in the output file (lines that do
+not start with a value are skipped), and writes to out_file every failing
+pattern with its mismatching primary outputs, then the mismatch count of
+every output.  Masked outputs are not compared.
+
+*************************************************************************/
+
+void verify_responses(circuit_t *ckt, FILE *pat_file, FILE *out_file)
+{
+  psim_t *ps;
+  word_t *izero, *ione, *ezero, *eone, *miss, any, m;
+  long long *po_count, npatterns, nfailing, nmismatch, base;
+  signed char vtab[256];
+  char *line, *rest;
+  int line_size, line_count, n, p, i, j, g;
+
+  for (i = 0; i < 256; i++)
+    vtab[i] = (signed char)value_of(i);
+
+  line_size = 2 * (ckt->npi + ckt->npo) + 256;
+  line = (char *)malloc(line_size);
+  izero = (word_t *)malloc((ckt->npi + 1) * sizeof(word_t));
+  ione = (word_t *)malloc((ckt->npi + 1) * sizeof(word_t));
+  ezero = (word_t *)malloc((ckt->npo + 1) * sizeof(word_t));
+  eone = (word_t *)malloc((ckt->npo + 1) * sizeof(word_t));
+  miss = (word_t *)malloc((ckt->npo + 1) * sizeof(word_t));
+  po_count = (long long *)calloc(ckt->npo + 1, sizeof(long long));
+
+  fprintf(out_file, "Mismatches:\n");
+  ps = psim_create(ckt);
+  npatterns = nfailing = nmismatch = 0;
+  line_count = 0;
+  do
+  {
+    /* next block */
+    memset(izero, 0, ckt->npi * sizeof(word_t));
+    memset(ione, 0, ckt->npi * sizeof(word_t));
+    memset(ezero, 0, ckt->npo * sizeof(word_t));
+    memset(eone, 0, ckt->npo * sizeof(word_t));
+    for (n = 0; n < WORD_BITS &&
+                next_line(pat_file, line, line_size, &line_count);)
+    {
+      rest = parse_inputs(ckt, vtab, line, line_count, izero, ione, n, NULL);
+      if (rest == NULL)
+        continue;
+      parse_expected(ckt, vtab, rest, line_count, ezero, eone, n);
+      n++;
+    }
+    if (n == 0)
+      break;
+    base = npatterns;
+    npatterns += n;
+
+    load_block(ps, izero, ione, n);
+    psim_good_eval(ps);
+    any = 0;
+    for (j = 0; j < ckt->npo; j++)
+    {
+      g = ckt->po[j];
+      miss[j] = 0;
+      if (ckt->po_mask != NULL && ckt->po_mask[j])
+        continue;
+      miss[j] = ((eone[j] & ~ps->one[g]) | (ezero[j] & ~ps->zero[g])) &
+                ps->valid;
+      po_count[j] += popcount(miss[j]);
+      any |= miss[j];
+    }
+    if (any == 0)
+      continue;
+
+    /* one line per failing pattern, in order */
+    nfailing += popcount(any);
+    for (m = any; m != 0; m &= m - 1)
+    {
+      p = lowest_lane(m);
+      fprintf(out_file, "%lld:", base + p);
+      for (j = 0; j < ckt->npo; j++)
+      {
+        if (!(miss[j] & LANE(p)))
+          continue;
+        g = ckt->po[j];
+        fprintf(out_file, " %s (expected %c, simulated %c)",
+                ckt->gate[g].name, value_char(ezero[j], eone[j], p),
+                value_char(ps->zero[g], ps->one[g], p));
+        nmismatch++;
+      }
+      fprintf(out_file, "\n");
+    }
+  } while (n == WORD_BITS);
+  psim_free(ps);
+  if (nfailing == 0)
+    fprintf(out_file, "(Empty)\n");
+
+  fprintf(out_file, "\nMismatches per Output:\n");
+  for (j = 0; j < ckt->npo; j++)
+  {
+    if (po_count[j] > 0)
+      fprintf(out_file, "%s %lld\n", ckt->gate[ckt->po[j]].name, po_count[j]);
+  }
+  if (nmismatch == 0)
+    fprintf(out_file, "(Empty)\n");
+  fprintf(out_file, "\nPatterns = %lld, Failing Patterns = %lld, "
+                    "Mismatches = %lld\n",
+          npatterns, nfailing, nmismatch);
+  printf("Verified %lld patterns: %lld failing, %lld mismatches\n", npatterns,
+         nfailing, nmismatch);
+
+  free(line);
+  free(izero);
+  free(ione);
+  free(ezero);
+  free(eone);
+  free(miss);
+  free(po_count);
+}
+
+/*************************************************************************
+
+Function:  good_simulate
+
+Purpose:  Reads patterns from pat_file (lines that do not start with a
+value are skipped, anything after the inputs is ignored) and writes their
+fault-free responses to out_file, as the "inputs -> outputs" lines of the
+output file.  Each block is formatted in one buffer and written at once.
+
+Return:  Number of patterns simulated.
+
+*************************************************************************/
+
+long long good_simulate(circuit_t *ckt, FILE *pat_file, FILE *out_file)
+{
+  psim_t *ps;
+  word_t *izero, *ione, z, o;
+  long long npatterns;
+  signed char vtab[256];
+  char *line, *text, *buf, *s;
+  int line_size, line_width, line_count, n, p, i, j, g;
+
+  for (i = 0; i < 256; i++)
+    vtab[i] = (signed char)value_of(i);
+
+  line_size = 2 * (ckt->npi + ckt->npo) + 256;
+  line = (char *)malloc(line_size);
+  line_width = ckt->npi + 4 + ckt->npo + 1; /* "inputs -> outputs\n" */
+  text = (char *)malloc((size_t)WORD_BITS * ckt->npi + 1);
+  buf = (char *)malloc((size_t)WORD_BITS * line_width + 1);
+  izero = (word_t *)malloc((ckt->npi + 1) * sizeof(word_t));
+  ione = (word_t *)malloc((ckt->npi + 1) * sizeof(word_t));
+
+  ps = psim_create(ckt);
+  npatterns = 0;
+  line_count = 0;
+  do
+  {
+    memset(izero, 0, ckt->npi * sizeof(word_t));
+    memset(ione, 0, ckt->npi * sizeof(word_t));
+    for (n = 0; n < WORD_BITS &&
+                next_line(pat_file, line, line_size, &line_count);)
+    {
+      if (parse_inputs(ckt, vtab, line, line_count, izero, ione, n,
+                       &text[(size_t)n * ckt->npi]) != NULL)
+        n++;
+    }
+    if (n == 0)
+      break;
+    npatterns += n;
+
+    load_block(ps, izero, ione, n);
+    psim_good_eval(ps);
+    for (p = 0; p < n; p++)
+    {
+      s = &buf[(size_t)p * line_width];
+      memcpy(s, &text[(size_t)p * ckt->npi], ckt->npi);
+      s += ckt->npi;
+      memcpy(s, " -> ", 4);
+      s += 4;
+      for (j = 0; j < ckt->npo; j++)
+      {
+        g = ckt->po[j];
+        z = ps->zero[g] >> p;
+        o = ps->one[g] >> p;
+        *s++ = (o & 1) ? '1' : (z & 1) ? '0' : '2';
+      }
+      *s = '\n';
+    }
+    fwrite(buf, line_width, n, out_file);
+  } while (n == WORD_BITS);
+  psim_free(ps);
+
+  free(line);
+  free(text);
+  free(buf);
+  free(izero);
+  free(ione);
+  return (npatterns);
+}